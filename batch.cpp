@@ -0,0 +1,210 @@
+/* batch.cpp
+ Cache-blocked, prefetching batch evaluation.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include "batch.h"
+#include "simd.h"
+
+using namespace std;
+
+void decode_options(const ScenarioTable& table, const double* vars, uint8_t* opts) {
+	for (int progIdx = 0; progIdx < table.nPrograms; progIdx++)
+		opts[progIdx] = (uint8_t)option_index(vars[progIdx], table.options(progIdx));
+}
+
+// Evaluates solutions [first, last), at most BATCH_GROUP of them.
+SIMD_KERNEL void group_kernel(const ScenarioTable& table, const uint8_t* opts, int first, int last,
+		double* objs, double* consts) {
+	const int nPrograms = table.nPrograms;
+	const uint32_t* offsets = &table.offsets[0];
+	const double* rows = &table.rows[0];
+	double acc[BATCH_GROUP][nColumns];
+
+	for (int s = first; s < last; s++)
+		acc[s - first][COL_BAU] = acc[s - first][COL_SS] = acc[s - first][COL_COST] = 0.0;
+
+	for (int p0 = 0; p0 < nPrograms; p0 += BATCH_BLOCK_PROGRAMS) {
+		int p1 = min(nPrograms, p0 + BATCH_BLOCK_PROGRAMS);
+		int pf = max(p0, p1 - PREFETCH_DISTANCE); // last program with a prefetch target in range
+
+		for (int s = first; s < last; s++) {
+			const uint8_t* sol = opts + (size_t)s * nPrograms;
+			double bau = acc[s - first][COL_BAU];
+			double ss = acc[s - first][COL_SS];
+			double cost = acc[s - first][COL_COST];
+			int progIdx = p0;
+
+			for (; progIdx < pf; progIdx++) {
+				int ahead = progIdx + PREFETCH_DISTANCE;
+				__builtin_prefetch(rows + (offsets[ahead] + sol[ahead]) * TABLE_STRIDE);
+
+				const double* row = rows + (offsets[progIdx] + sol[progIdx]) * TABLE_STRIDE;
+				bau += row[COL_BAU];
+				ss += row[COL_SS];
+				cost += row[COL_COST];
+			}
+
+			for (; progIdx < p1; progIdx++) {
+				const double* row = rows + (offsets[progIdx] + sol[progIdx]) * TABLE_STRIDE;
+				bau += row[COL_BAU];
+				ss += row[COL_SS];
+				cost += row[COL_COST];
+			}
+
+			acc[s - first][COL_BAU] = bau;
+			acc[s - first][COL_SS] = ss;
+			acc[s - first][COL_COST] = cost;
+		}
+	}
+
+	const int nConstraints = table.constraints();
+
+	for (int s = first; s < last; s++) {
+		const double* sums = acc[s - first];
+		const uint8_t* sol = opts + (size_t)s * nPrograms;
+
+		objs[s * nColumns + COL_BAU] = sums[COL_BAU] * table.scale[COL_BAU];
+		objs[s * nColumns + COL_SS] = sums[COL_SS] * table.scale[COL_SS];
+		objs[s * nColumns + COL_COST] = sums[COL_COST] * table.scale[COL_COST];
+		consts[s * nConstraints] = max(0.0, sums[COL_COST] - table.budget);
+
+		if (table.nYears > 0)
+			year_constraints(table, [sol](int progIdx) { return sol[progIdx]; }, consts + s * nConstraints + 1);
+	}
+}
+
+static void group_sse2(const ScenarioTable& table, const uint8_t* opts, int first, int last, double* objs,
+		double* consts) {
+	group_kernel(table, opts, first, last, objs, consts);
+}
+
+SIMD_TARGET_AVX2 static void group_avx2(const ScenarioTable& table, const uint8_t* opts, int first, int last,
+		double* objs, double* consts) {
+	group_kernel(table, opts, first, last, objs, consts);
+}
+
+SIMD_TARGET_AVX512 static void group_avx512(const ScenarioTable& table, const uint8_t* opts, int first, int last,
+		double* objs, double* consts) {
+	group_kernel(table, opts, first, last, objs, consts);
+}
+
+struct BatchJob {
+	const ScenarioTable* table;
+	const uint8_t* opts;
+	int nSolutions;
+	double* objs;
+	double* consts;
+};
+
+static void batch_task(int task, int worker, void* context) {
+	BatchJob* job = (BatchJob*)context;
+	int first = task * BATCH_GROUP;
+	int last = min(job->nSolutions, first + BATCH_GROUP);
+
+	SIMD_DISPATCH(group, (*job->table, job->opts, first, last, job->objs, job->consts));
+}
+
+void evaluate_batch(const ScenarioTable& table, const uint8_t* opts, int nSolutions,
+		double* objs, double* consts, ThreadPool* pool) {
+	BatchJob job = { &table, opts, nSolutions, objs, consts };
+	int nGroups = (nSolutions + BATCH_GROUP - 1) / BATCH_GROUP;
+
+	if (pool != NULL) {
+		pool->run(nGroups, batch_task, &job);
+	} else {
+		for (int group = 0; group < nGroups; group++)
+			batch_task(group, 0, &job);
+	}
+}
+
+struct ScreenJob {
+	const ScenarioTable* table;
+	const uint8_t* opts;
+	int nSolutions;
+	double* objs;
+	double* consts;
+	std::atomic<int> infeasible;
+};
+
+// Cost of one solution in program order.  Returns true if it is within
+// the budget.
+static bool screen_cost(const ScenarioTable& table, const uint8_t* sol, double& cost) {
+	const int nPrograms = table.nPrograms;
+	const uint32_t* offsets = &table.offsets[0];
+	const double* rows = &table.rows[0];
+	double sum = 0;
+
+	for (int progIdx = 0; progIdx < nPrograms; progIdx++)
+		sum += rows[(offsets[progIdx] + sol[progIdx]) * TABLE_STRIDE + COL_COST];
+
+	cost = sum;
+	return sum <= table.budget;
+}
+
+static void screen_task(int task, int worker, void* context) {
+	ScreenJob* job = (ScreenJob*)context;
+	const ScenarioTable& table = *job->table;
+	const int nPrograms = table.nPrograms;
+	const int nConstraints = table.constraints();
+	const uint32_t* offsets = &table.offsets[0];
+	const double* rows = &table.rows[0];
+	const int first = task * BATCH_GROUP;
+	const int last = min(job->nSolutions, first + BATCH_GROUP);
+	int infeasible = 0;
+
+	for (int s = first; s < last; s++) {
+		const uint8_t* sol = job->opts + (size_t)s * nPrograms;
+		double* objs = job->objs + s * nColumns;
+		double* consts = job->consts + s * nConstraints;
+		double cost;
+
+		if (screen_cost(table, sol, cost)) {
+			double bau = 0, ss = 0;
+			for (int progIdx = 0; progIdx < nPrograms; progIdx++) {
+				const double* row = rows + (offsets[progIdx] + sol[progIdx]) * TABLE_STRIDE;
+				bau += row[COL_BAU];
+				ss += row[COL_SS];
+			}
+
+			objs[COL_BAU] = bau * table.scale[COL_BAU];
+			objs[COL_SS] = ss * table.scale[COL_SS];
+		} else {
+			objs[COL_BAU] = table.nadir[COL_BAU];
+			objs[COL_SS] = table.nadir[COL_SS];
+			infeasible++;
+		}
+
+		objs[COL_COST] = cost * table.scale[COL_COST];
+		consts[0] = max(0.0, cost - table.budget);
+
+		if (table.nYears > 0)
+			year_constraints(table, [sol](int progIdx) { return sol[progIdx]; }, consts + 1);
+	}
+
+	job->infeasible += infeasible;
+}
+
+int evaluate_batch_screened(const ScenarioTable& table, const uint8_t* opts, int nSolutions,
+		double* objs, double* consts, ThreadPool* pool) {
+	ScreenJob job;
+	int nGroups = (nSolutions + BATCH_GROUP - 1) / BATCH_GROUP;
+
+	job.table = &table;
+	job.opts = opts;
+	job.nSolutions = nSolutions;
+	job.objs = objs;
+	job.consts = consts;
+	job.infeasible = 0;
+
+	if (pool != NULL) {
+		pool->run(nGroups, screen_task, &job);
+	} else {
+		for (int group = 0; group < nGroups; group++)
+			screen_task(group, 0, &job);
+	}
+
+	return job.infeasible;
+}
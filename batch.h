@@ -0,0 +1,43 @@
+/*
+ * batch.h
+ *
+ *  Batched evaluation for large models.  Solutions are decoded to one byte
+ *  per program and evaluated in groups: the programs are walked in blocks
+ *  small enough for the block's table rows to stay in cache while every
+ *  solution of the group accumulates over them, with the rows for upcoming
+ *  programs prefetched.  Groups are spread over a thread pool.
+ *
+ *  Each solution's sums are still accumulated in program order, so results
+ *  are identical to evaluate_table.
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdint.h>
+#include "portfolio.h"
+#include "threadpool.h"
+
+#define BATCH_GROUP 16           // solutions sharing one pass over a program block
+#define BATCH_BLOCK_PROGRAMS 512 // programs per block
+#define PREFETCH_DISTANCE 8      // programs ahead to prefetch
+
+// Decodes real-valued decision variables into option indices.
+void decode_options(const ScenarioTable& table, const double* vars, uint8_t* opts);
+
+// Evaluates nSolutions portfolios stored as consecutive rows of nPrograms
+// option indices, writing nColumns objectives and table.constraints()
+// constraints per solution.
+// The pool may be NULL to evaluate on the calling thread.
+void evaluate_batch(const ScenarioTable& table, const uint8_t* opts, int nSolutions,
+		double* objs, double* consts, ThreadPool* pool);
+
+// Constraint-first variant of evaluate_batch.  Cost is summed first, and
+// the bau and ss sums only for solutions within the budget.  Infeasible
+// solutions get the scenario's nadir (table.nadir) for bau and ss.  Cost and the constraints are always
+// exact, and feasible solutions get the same results as evaluate_batch.
+// Returns the number found infeasible.
+int evaluate_batch_screened(const ScenarioTable& table, const uint8_t* opts, int nSolutions,
+		double* objs, double* consts, ThreadPool* pool);
+
+#endif /* BATCH_H_ */
@@ -5,7 +5,7 @@
 namespace ublas = boost::numeric::ublas;
 using namespace std;
 
-double vsum(ublas::vector<double> v)
+inline double vsum(ublas::vector<double> v)
 {
   double s = 0.0;
   for(unsigned int i = 0; i < v.size(); i++)
@@ -13,23 +13,23 @@ double vsum(ublas::vector<double> v)
   return s;
 }
 
-double vmax(ublas::vector<double> v)
+inline double vmax(ublas::vector<double> v)
 {
   return *max_element(v.begin(), v.end());
 }
 
-double vmin(ublas::vector<double> v)
+inline double vmin(ublas::vector<double> v)
 {
   return *min_element(v.begin(), v.end());
 }
 
-void zero(ublas::vector<double> & v)
+inline void zero(ublas::vector<double> & v)
 {
   for(unsigned int i = 0; i < v.size(); i++)
     v(i) = 0.0;
 }
 
-void loadtxt(string fname, ublas::matrix<double> & M)
+inline void loadtxt(string fname, ublas::matrix<double> & M)
 {
   ifstream f (fname.c_str());
     
@@ -46,7 +46,7 @@ void loadtxt(string fname, ublas::matrix<double> & M)
   f.close(); 
 }
 
-void savetxt(string fname, ublas::matrix<double> & M)
+inline void savetxt(string fname, ublas::matrix<double> & M)
 {
   ofstream f (fname.c_str());
 
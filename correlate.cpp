@@ -0,0 +1,192 @@
+/* correlate.cpp
+ Cholesky factorization of program correlations and blocked sampling.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include "correlate.h"
+#include "boostutil.h"
+#include "simd.h"
+
+using namespace std;
+
+// Offset of the panel of row block b: block b holds CORR_ROW_BLOCK rows and
+// CORR_ROW_BLOCK*(b+1) columns, interleaved so the coefficients of one
+// column are adjacent.
+static size_t panel_offset(int b) {
+	return (size_t)CORR_ROW_BLOCK * CORR_ROW_BLOCK * b * (b + 1) / 2;
+}
+
+void load_correlation(const char* filename, int nPrograms, ublas::matrix<double>& correlation) {
+	correlation.resize(nPrograms, nPrograms, false);
+	for (int i = 0; i < nPrograms; i++)
+		for (int j = 0; j < nPrograms; j++)
+			correlation(i, j) = NAN; // entries missing from the file stay NaN
+
+	loadtxt(filename, correlation);
+}
+
+void init_sampler(CorrelatedSampler& sampler, const ublas::matrix<double>& correlation, unsigned int seed) {
+	const int n = (int)correlation.size1();
+
+	if (correlation.size2() != correlation.size1()) {
+		fprintf(stderr, "Correlation matrix must be square\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (!(correlation(i, i) == 1.0)) {
+			fprintf(stderr, "Correlation matrix has %g on the diagonal at %d (missing entries?)\n",
+					correlation(i, i), i + 1);
+			exit(EXIT_FAILURE);
+		}
+
+		for (int j = 0; j < i; j++) {
+			if (!(fabs(correlation(i, j) - correlation(j, i)) <= 1e-9) || !(fabs(correlation(i, j)) <= 1.0)) {
+				fprintf(stderr, "Correlation matrix is not symmetric with entries in [-1, 1] at (%d, %d)\n",
+						i + 1, j + 1);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	/* Cholesky: correlation = L L' */
+	sampler.nPrograms = n;
+	sampler.factor.resize(n, n, false);
+
+	for (int j = 0; j < n; j++) {
+		double d = correlation(j, j);
+		for (int k = 0; k < j; k++)
+			d -= sampler.factor(j, k) * sampler.factor(j, k);
+
+		if (!(d > 1e-12)) {
+			fprintf(stderr, "Correlation matrix is not positive definite (pivot %d)\n", j + 1);
+			exit(EXIT_FAILURE);
+		}
+		sampler.factor(j, j) = sqrt(d);
+
+		for (int i = j + 1; i < n; i++) {
+			double s = correlation(i, j);
+			for (int k = 0; k < j; k++)
+				s -= sampler.factor(i, k) * sampler.factor(j, k);
+			sampler.factor(i, j) = s / sampler.factor(j, j);
+		}
+	}
+
+	/* copy into row block panels, zero above the diagonal */
+	const int nBlocks = (n + CORR_ROW_BLOCK - 1) / CORR_ROW_BLOCK;
+	sampler.packed.assign(panel_offset(nBlocks), 0.0);
+
+	for (int b = 0; b < nBlocks; b++) {
+		double* panel = &sampler.packed[panel_offset(b)];
+
+		for (int r = 0; r < CORR_ROW_BLOCK && b * CORR_ROW_BLOCK + r < n; r++) {
+			int i = b * CORR_ROW_BLOCK + r;
+			for (int j = 0; j <= i; j++)
+				panel[j * CORR_ROW_BLOCK + r] = sampler.factor(i, j);
+		}
+	}
+
+	sampler.rng.seed(seed);
+	sampler.normal.reset();
+}
+
+struct CorrelateJob {
+	const CorrelatedSampler* sampler;
+	const double* z;
+	double* x;
+	int nSamples;
+};
+
+// One block of CORR_SAMPLE_BLOCK samples through every row block of L.
+SIMD_KERNEL void correlate_kernel(const CorrelateJob* job, int task) {
+	const int n = job->sampler->nPrograms;
+	const int nSamples = job->nSamples;
+	const int s0 = task * CORR_SAMPLE_BLOCK;
+	const double* packed = &job->sampler->packed[0];
+
+	for (int b = 0; b * CORR_ROW_BLOCK < n; b++) {
+		const double* panel = packed + panel_offset(b);
+		const int nCols = min(n, (b + 1) * CORR_ROW_BLOCK);
+		v4df acc[CORR_ROW_BLOCK];
+
+		for (int r = 0; r < CORR_ROW_BLOCK; r++)
+			acc[r] = v4df { 0.0, 0.0, 0.0, 0.0 };
+
+		for (int j = 0; j < nCols; j++) {
+			v4df zj = load4(job->z + (size_t)j * nSamples + s0);
+
+			for (int r = 0; r < CORR_ROW_BLOCK; r++)
+				acc[r] += panel[j * CORR_ROW_BLOCK + r] * zj;
+		}
+
+		for (int r = 0; r < CORR_ROW_BLOCK && b * CORR_ROW_BLOCK + r < n; r++) {
+			store4(job->x + (size_t)(b * CORR_ROW_BLOCK + r) * nSamples + s0, acc[r]);
+		}
+	}
+}
+
+static void correlate_sse2(const CorrelateJob* job, int task) {
+	correlate_kernel(job, task);
+}
+
+SIMD_TARGET_AVX2 static void correlate_avx2(const CorrelateJob* job, int task) {
+	correlate_kernel(job, task);
+}
+
+SIMD_TARGET_AVX512 static void correlate_avx512(const CorrelateJob* job, int task) {
+	correlate_kernel(job, task);
+}
+
+static void correlate_task(int task, int worker, void* context) {
+	SIMD_DISPATCH(correlate, ((const CorrelateJob*)context, task));
+}
+
+void correlate(const CorrelatedSampler& sampler, const double* z, double* x, int nSamples, ThreadPool* pool) {
+	const int n = sampler.nPrograms;
+	const int nBlocks = nSamples / CORR_SAMPLE_BLOCK;
+	CorrelateJob job = { &sampler, z, x, nSamples };
+
+	if (pool != NULL) {
+		pool->run(nBlocks, correlate_task, &job);
+	} else {
+		for (int block = 0; block < nBlocks; block++)
+			correlate_task(block, 0, &job);
+	}
+
+	/* samples left over after the last full block */
+	for (int s = nBlocks * CORR_SAMPLE_BLOCK; s < nSamples; s++) {
+		for (int i = 0; i < n; i++) {
+			double sum = 0;
+			for (int j = 0; j <= i; j++)
+				sum += sampler.factor(i, j) * z[(size_t)j * nSamples + s];
+			x[(size_t)i * nSamples + s] = sum;
+		}
+	}
+}
+
+void correlated_normals(CorrelatedSampler& sampler, int nSamples, double* x, ThreadPool* pool) {
+	const size_t count = (size_t)sampler.nPrograms * nSamples;
+
+	if (sampler.z.size() < count)
+		sampler.z.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+		sampler.z[i] = sampler.normal(sampler.rng);
+
+	correlate(sampler, &sampler.z[0], x, nSamples, pool);
+}
+
+void correlated_multipliers(CorrelatedSampler& sampler, int nSamples, double sigma, double mean,
+		double* multipliers, ThreadPool* pool) {
+	const double mu = log(mean) - sigma * sigma / 2; // E[exp(mu + sigma*x)] = mean
+	const size_t count = (size_t)sampler.nPrograms * nSamples;
+
+	correlated_normals(sampler, nSamples, multipliers, pool);
+
+	for (size_t i = 0; i < count; i++)
+		multipliers[i] = exp(mu + sigma * multipliers[i]);
+}
@@ -0,0 +1,57 @@
+/*
+ * correlate.h
+ *
+ *  Correlated sampling of program uncertainty.  A correlation matrix over the
+ *  programs is factored once into its lower triangular Cholesky factor L;
+ *  correlated standard normals are then x = L z for independent normals z,
+ *  and the lognormal multipliers exp(mu + sigma*x) have the requested mean.
+ *
+ *  Samples are stored program by program (sample s of program p at
+ *  p*nSamples + s), the layout MonteCarlo::growth uses, and the product L z
+ *  is taken for blocks of programs and samples at once so each row of L and
+ *  each panel of z is loaded once per register tile.
+ */
+
+#ifndef CORRELATE_H_
+#define CORRELATE_H_
+
+#include <vector>
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/numeric/ublas/triangular.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include "threadpool.h"
+
+#define CORR_ROW_BLOCK 4    // rows of L per register tile
+#define CORR_SAMPLE_BLOCK 4 // samples per register tile
+
+struct CorrelatedSampler {
+	int nPrograms;
+	boost::numeric::ublas::triangular_matrix<double, boost::numeric::ublas::lower> factor;
+	std::vector<double> packed; // factor rows padded to CORR_ROW_BLOCK, row i at i*nPrograms
+
+	boost::random::mt19937 rng;
+	boost::random::normal_distribution<double> normal;
+	std::vector<double> z;      // workspace: independent normals
+};
+
+// Reads an nPrograms x nPrograms correlation matrix, whitespace separated.
+void load_correlation(const char* filename, int nPrograms, boost::numeric::ublas::matrix<double>& correlation);
+
+// Factors the correlation matrix; exits if it is not a symmetric, positive
+// definite matrix with a unit diagonal.
+void init_sampler(CorrelatedSampler& sampler, const boost::numeric::ublas::matrix<double>& correlation,
+		unsigned int seed);
+
+// x = L z for nSamples independent normal vectors z, both program by program.
+void correlate(const CorrelatedSampler& sampler, const double* z, double* x, int nSamples, ThreadPool* pool);
+
+// Draws nSamples correlated standard normal vectors.
+void correlated_normals(CorrelatedSampler& sampler, int nSamples, double* x, ThreadPool* pool);
+
+// Draws nSamples vectors of lognormal multipliers with the given mean and
+// log-scale standard deviation, correlated through the sampler's factor.
+void correlated_multipliers(CorrelatedSampler& sampler, int nSamples, double sigma, double mean,
+		double* multipliers, ThreadPool* pool);
+
+#endif /* CORRELATE_H_ */
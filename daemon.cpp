@@ -0,0 +1,173 @@
+/* daemon.cpp
+ Request loop with per-request scenarios and an LRU cache of scenario tables.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "daemon.h"
+#include "batch.h"
+#include "ensemble.h"
+#include "moeaframework.h"
+#include "stats.h"
+
+using namespace std;
+
+void init_table_cache(TableCache& cache, size_t capacity) {
+	cache.capacity = max((size_t)1, capacity);
+	cache.entries.clear();
+	cache.index.clear();
+	cache.hits = 0;
+	cache.misses = 0;
+}
+
+const ScenarioTable& cached_table(TableCache& cache, const PortfolioModel& model, const vector<double>& inputs) {
+	map<vector<double>, list<TableCache::Entry>::iterator>::iterator found = cache.index.find(inputs);
+
+	if (found != cache.index.end()) {
+		cache.hits++;
+		STATS_COUNT(COUNT_CACHE_HITS, 1);
+		cache.entries.splice(cache.entries.begin(), cache.entries, found->second);
+		return found->second->second;
+	}
+
+	cache.misses++;
+	STATS_COUNT(COUNT_CACHE_MISSES, 1);
+	if (cache.entries.size() >= cache.capacity) {
+		cache.index.erase(cache.entries.back().first);
+		cache.entries.pop_back();
+	}
+
+	Scenario scenario;
+	scenario_from_inputs(model, &inputs[0], 1, 0, scenario);
+
+	cache.entries.push_front(TableCache::Entry(inputs, ScenarioTable()));
+	build_scenario_table(model, scenario, cache.entries.front().second);
+	cache.index[inputs] = cache.entries.begin();
+	return cache.entries.front().second;
+}
+
+static void base_inputs(const PortfolioModel& model, const Scenario& base, vector<double>& inputs) {
+	const int n = model.nPrograms;
+
+	inputs.assign(base.uncertainty.begin(), base.uncertainty.end());
+	inputs.resize(SCENARIO_INPUTS(n));
+	inputs[INPUT_BAU_SCALE(n)] = base.bauScale;
+	inputs[INPUT_SS_SCALE(n)] = base.ssScale;
+	inputs[INPUT_COST_SCALE(n)] = base.costScale;
+	inputs[INPUT_BUDGET_SCALE(n)] = base.budgetScale;
+}
+
+/* Request lines are parsed with the error callback off, so a malformed
+ * request gets an error reply instead of ending the daemon.  Returns NULL
+ * or why the line was rejected. */
+static const char* read_request(int size, double* values) {
+	void (*callback)(const MOEA_Status) = MOEA_Error_callback;
+
+	MOEA_Error_callback = NULL;
+	MOEA_Status status = MOEA_Read_doubles(size, values);
+	MOEA_Error_callback = callback;
+	return status == MOEA_SUCCESS ? NULL : MOEA_Status_message(status);
+}
+
+// The rest of a "scenario" line: "default" or a row of the library.  On
+// error the scenario is left unchanged.
+static const char* read_scenario(const PortfolioModel& model, const Scenario& base, const vector<double>& library,
+		int nLibrary, vector<double>& inputs, uint32_t& scenarioId) {
+	const int n = model.nPrograms;
+	const char* error;
+	double id;
+
+	if (MOEA_Read_keyword("default")) {
+		base_inputs(model, base, inputs);
+		scenarioId = TRACE_SCENARIO_BASE;
+		return NULL;
+	}
+
+	if ((error = read_request(1, &id)) != NULL)
+		return error;
+	if (id < 0 || id >= nLibrary || id != (int)id)
+		return "Scenario is not in the scenario library";
+
+	for (int i = 0; i < SCENARIO_INPUTS(n); i++)
+		inputs[i] = library[(size_t)i * nLibrary + (int)id];
+	scenarioId = (uint32_t)id;
+	return NULL;
+}
+
+// The rest of a "multipliers" line.  On error the scenario is left unchanged.
+static const char* read_multipliers(int n, vector<double>& inputs, uint32_t& scenarioId) {
+	vector<double> given(SCENARIO_INPUTS(n), 1.0);
+	const char* error;
+
+	if ((error = read_request(n, &given[0])) != NULL)
+		return error;
+	if (!MOEA_End_of_line() && (error = read_request(SCENARIO_INPUTS(n) - n, &given[n])) != NULL)
+		return error;
+
+	inputs.swap(given);
+	scenarioId = TRACE_SCENARIO_INLINE;
+	return NULL;
+}
+
+void run_daemon(const PortfolioModel& model, const Scenario& base, const vector<double>& library,
+		int nLibrary, size_t cacheSize, TraceWriter* capture) {
+	const int n = model.nPrograms;
+	TableCache cache;
+	vector<double> inputs, vars(n);
+	vector<uint8_t> opts(n);
+	uint32_t scenarioId = TRACE_SCENARIO_BASE;
+
+	init_table_cache(cache, cacheSize);
+	base_inputs(model, base, inputs);
+	const ScenarioTable* table = &cached_table(cache, model, inputs);
+
+	vector<double> objs(nColumns), consts(table->constraints());
+
+	STATS_START();
+	while (MOEA_Next_solution() == MOEA_SUCCESS) {
+		STATS_LAP(PHASE_READ);
+
+		const char* error;
+		bool isScenario = MOEA_Read_keyword("scenario") != 0;
+
+		if (isScenario || MOEA_Read_keyword("multipliers")) {
+			if (isScenario)
+				error = read_scenario(model, base, library, nLibrary, inputs, scenarioId);
+			else
+				error = read_multipliers(n, inputs, scenarioId);
+
+			if (error == NULL) {
+				table = &cached_table(cache, model, inputs);
+				STATS_LAP(PHASE_PARSE);
+				continue;
+			}
+		} else {
+			error = read_request(n, &vars[0]);
+		}
+
+		STATS_LAP(PHASE_PARSE);
+		if (error != NULL) {
+			MOEA_Write_error(error);
+		} else {
+			evaluate_table(*table, &vars[0], &objs[0], &consts[0]);
+			if (capture != NULL) {
+				decode_options(*table, &vars[0], &opts[0]);
+				trace_record(*capture, scenarioId, &opts[0], &objs[0], &consts[0]);
+			}
+			STATS_LAP(PHASE_EVALUATE);
+			MOEA_Write_buffered(&objs[0], &consts[0]);
+			STATS_LAP(PHASE_FORMAT);
+			STATS_COUNT(COUNT_SOLUTIONS, 1);
+		}
+
+		if (!MOEA_Input_pending()) {
+			MOEA_Flush();
+			STATS_LAP(PHASE_FLUSH);
+			STATS_COUNT(COUNT_BATCHES, 1);
+			STATS_POLL();
+		}
+	}
+
+	MOEA_Flush();
+}
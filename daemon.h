@@ -0,0 +1,51 @@
+/*
+ * daemon.h
+ *
+ *  Daemon mode: one process serves solutions under any number of scenarios.
+ *  Besides decision variables, an input line may switch the scenario used
+ *  for the solutions that follow:
+ *
+ *    scenario <id>                 row id (from 0) of the scenario library
+ *    scenario default              the scenario given on the command line
+ *    multipliers <u1> ... <un> [<bau> <ss> <cost> <budget>]
+ *
+ *  These lines produce no output.  A line that cannot be parsed, or names a
+ *  scenario not in the library, is answered with "error" and the reason
+ *  instead, and leaves the scenario unchanged.  The tables of the most
+ *  recently used scenarios are kept in an LRU cache, so switching back and
+ *  forth between scenarios does not rebuild them.
+ */
+
+#ifndef DAEMON_H_
+#define DAEMON_H_
+
+#include <list>
+#include <map>
+#include <vector>
+#include "portfolio.h"
+#include "trace.h"
+
+struct TableCache {
+	typedef std::pair<std::vector<double>, ScenarioTable> Entry; // scenario inputs and their table
+
+	size_t capacity;
+	std::list<Entry> entries;  // most recently used first
+	std::map<std::vector<double>, std::list<Entry>::iterator> index;
+	unsigned long hits;
+	unsigned long misses;
+};
+
+void init_table_cache(TableCache& cache, size_t capacity);
+
+// The table of the scenario with the given inputs (SCENARIO_INPUTS values in
+// the order of ensemble.h), built on a miss.  The reference stays valid until
+// capacity other scenarios have been looked up.
+const ScenarioTable& cached_table(TableCache& cache, const PortfolioModel& model, const std::vector<double>& inputs);
+
+// Serves requests from the MOEA streams until end of input.  library holds
+// nLibrary scenarios stored input by input as load_scenarios reads them.
+// Evaluations are recorded to capture unless it is NULL.
+void run_daemon(const PortfolioModel& model, const Scenario& base, const std::vector<double>& library,
+		int nLibrary, size_t cacheSize, TraceWriter* capture);
+
+#endif /* DAEMON_H_ */
@@ -0,0 +1,349 @@
+/* ensemble.cpp
+ One portfolio over many scenarios, vectorized across scenarios.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "ensemble.h"
+#include "simd.h"
+
+using namespace std;
+
+// W scenarios at a time in a V, then the rest one at a time.
+template <typename V>
+SIMD_KERNEL void ensemble_kernel(const PortfolioModel& model, const int* opts, const double* inputs, int nScenarios,
+		double* outputs) {
+	const int W = sizeof(V) / sizeof(double);
+	const int n = model.nPrograms;
+	const size_t stride = nScenarios;
+	const double* scales[nColumns] = {
+		inputs + INPUT_BAU_SCALE(n) * stride,
+		inputs + INPUT_SS_SCALE(n) * stride,
+		inputs + INPUT_COST_SCALE(n) * stride
+	};
+	const double* budgetScale = inputs + INPUT_BUDGET_SCALE(n) * stride;
+	const V zero = {};
+	const V threshold = zero + model.costThreshold;
+	int s = 0;
+
+	for (; s + W <= nScenarios; s += W) {
+		V bau = zero, ss = zero, cost = zero;
+
+		for (int progIdx = 0; progIdx < n; progIdx++) {
+			const double* row = model.row(progIdx, opts[progIdx]);
+			V u = loadv<V>(inputs + progIdx * stride + s);
+
+			bau += u * row[COL_BAU];
+			ss += u * row[COL_SS];
+			cost += u * row[COL_COST];
+		}
+
+		V over = cost - threshold * loadv<V>(budgetScale + s);
+
+		storev(outputs + 0 * stride + s, bau * loadv<V>(scales[COL_BAU] + s));
+		storev(outputs + 1 * stride + s, ss * loadv<V>(scales[COL_SS] + s));
+		storev(outputs + 2 * stride + s, cost * loadv<V>(scales[COL_COST] + s));
+		storev(outputs + 3 * stride + s, over > zero ? over : zero);
+	}
+
+	for (; s < nScenarios; s++)
+		evaluate_ensemble_scenario(model, opts, inputs, nScenarios, s, outputs);
+}
+
+static void ensemble_sse2(const PortfolioModel& model, const int* opts, const double* inputs, int nScenarios,
+		double* outputs) {
+	ensemble_kernel<v4df>(model, opts, inputs, nScenarios, outputs);
+}
+
+SIMD_TARGET_AVX2 static void ensemble_avx2(const PortfolioModel& model, const int* opts, const double* inputs,
+		int nScenarios, double* outputs) {
+	ensemble_kernel<v4df>(model, opts, inputs, nScenarios, outputs);
+}
+
+SIMD_TARGET_AVX512 static void ensemble_avx512(const PortfolioModel& model, const int* opts, const double* inputs,
+		int nScenarios, double* outputs) {
+	ensemble_kernel<v8df>(model, opts, inputs, nScenarios, outputs);
+}
+
+void evaluate_ensemble(const PortfolioModel& model, const int* opts, const double* inputs, int nScenarios,
+		double* outputs) {
+	SIMD_DISPATCH(ensemble, (model, opts, inputs, nScenarios, outputs));
+}
+
+void evaluate_ensemble_scenario(const PortfolioModel& model, const int* opts, const double* inputs,
+		int nScenarios, int s, double* outputs) {
+	const int n = model.nPrograms;
+	const size_t stride = nScenarios;
+	double bau = 0, ss = 0, cost = 0;
+
+	for (int progIdx = 0; progIdx < n; progIdx++) {
+		const double* row = model.row(progIdx, opts[progIdx]);
+		double u = inputs[progIdx * stride + s];
+
+		bau += u * row[COL_BAU];
+		ss += u * row[COL_SS];
+		cost += u * row[COL_COST];
+	}
+
+	outputs[0 * stride + s] = bau * inputs[INPUT_BAU_SCALE(n) * stride + s];
+	outputs[1 * stride + s] = ss * inputs[INPUT_SS_SCALE(n) * stride + s];
+	outputs[2 * stride + s] = cost * inputs[INPUT_COST_SCALE(n) * stride + s];
+	outputs[3 * stride + s] = max(0.0, cost - model.costThreshold * inputs[INPUT_BUDGET_SCALE(n) * stride + s]);
+}
+
+void init_float_ensemble(FloatEnsemble& ensemble, const PortfolioModel& model, const double* inputs,
+		int nScenarios) {
+	const int n = model.nPrograms;
+	const size_t stride = nScenarios;
+	const double gamma = (n + 4) * (double)FLT_EPSILON;
+
+	ensemble.nScenarios = nScenarios;
+	ensemble.inputs.assign(inputs, inputs + (size_t)n * stride);
+	ensemble.rows.assign(model.rows, model.rows + (size_t)model.nRows * nColumns);
+	ensemble.error.assign((size_t)nColumns * nScenarios, 0.0);
+	ensemble.budget.resize(nScenarios);
+
+	for (int progIdx = 0; progIdx < n; progIdx++) {
+		for (int c = 0; c < nColumns; c++) {
+			double largest = 0;
+			for (int optIdx = 0; optIdx < model.options(progIdx); optIdx++)
+				largest = max(largest, fabs(model.row(progIdx, optIdx)[c]));
+
+			for (int s = 0; s < nScenarios; s++)
+				ensemble.error[c * stride + s] += fabs(inputs[progIdx * stride + s]) * largest;
+		}
+	}
+
+	for (size_t i = 0; i < ensemble.error.size(); i++)
+		ensemble.error[i] *= gamma;
+	for (int s = 0; s < nScenarios; s++)
+		ensemble.budget[s] = model.costThreshold * inputs[INPUT_BUDGET_SCALE(n) * stride + s];
+}
+
+// The unscaled float sums, W scenarios at a time in a V, written to the
+// first three outputs.
+template <typename V>
+SIMD_KERNEL void float_sums_kernel(const FloatEnsemble& ensemble, const PortfolioModel& model, const int* opts,
+		double* outputs) {
+	const int W = sizeof(V) / sizeof(float);
+	const int n = model.nPrograms;
+	const int nScenarios = ensemble.nScenarios;
+	const size_t stride = nScenarios;
+	int s = 0;
+
+	for (; s + W <= nScenarios; s += W) {
+		V bau = {}, ss = {}, cost = {};
+
+		for (int progIdx = 0; progIdx < n; progIdx++) {
+			const float* row = &ensemble.rows[(model.offsets[progIdx] + opts[progIdx]) * nColumns];
+			V u = loadv<V>(&ensemble.inputs[progIdx * stride + s]);
+
+			bau += u * row[COL_BAU];
+			ss += u * row[COL_SS];
+			cost += u * row[COL_COST];
+		}
+
+		for (int k = 0; k < W; k++) {
+			outputs[0 * stride + s + k] = bau[k];
+			outputs[1 * stride + s + k] = ss[k];
+			outputs[2 * stride + s + k] = cost[k];
+		}
+	}
+
+	for (; s < nScenarios; s++) {
+		float bau = 0, ss = 0, cost = 0;
+
+		for (int progIdx = 0; progIdx < n; progIdx++) {
+			const float* row = &ensemble.rows[(model.offsets[progIdx] + opts[progIdx]) * nColumns];
+			float u = ensemble.inputs[progIdx * stride + s];
+
+			bau += u * row[COL_BAU];
+			ss += u * row[COL_SS];
+			cost += u * row[COL_COST];
+		}
+
+		outputs[0 * stride + s] = bau;
+		outputs[1 * stride + s] = ss;
+		outputs[2 * stride + s] = cost;
+	}
+}
+
+static void float_sums_sse2(const FloatEnsemble& ensemble, const PortfolioModel& model, const int* opts,
+		double* outputs) {
+	float_sums_kernel<v8sf>(ensemble, model, opts, outputs);
+}
+
+SIMD_TARGET_AVX2 static void float_sums_avx2(const FloatEnsemble& ensemble, const PortfolioModel& model,
+		const int* opts, double* outputs) {
+	float_sums_kernel<v8sf>(ensemble, model, opts, outputs);
+}
+
+SIMD_TARGET_AVX512 static void float_sums_avx512(const FloatEnsemble& ensemble, const PortfolioModel& model,
+		const int* opts, double* outputs) {
+	float_sums_kernel<v16sf>(ensemble, model, opts, outputs);
+}
+
+int evaluate_ensemble_float(const FloatEnsemble& ensemble, const PortfolioModel& model, const int* opts,
+		const double* inputs, double* outputs) {
+	const int n = model.nPrograms;
+	const int nScenarios = ensemble.nScenarios;
+	const size_t stride = nScenarios;
+	const double* costError = &ensemble.error[COL_COST * stride];
+	int rechecked = 0;
+
+	/* the sums in float, kept in the outputs until the scales are applied */
+	SIMD_DISPATCH(float_sums, (ensemble, model, opts, outputs));
+
+	for (int s = 0; s < nScenarios; s++) {
+		double cost = outputs[2 * stride + s];
+
+		if (fabs(cost - ensemble.budget[s]) <= costError[s]) {
+			evaluate_ensemble_scenario(model, opts, inputs, nScenarios, s, outputs);
+			rechecked++;
+			continue;
+		}
+
+		outputs[0 * stride + s] *= inputs[INPUT_BAU_SCALE(n) * stride + s];
+		outputs[1 * stride + s] *= inputs[INPUT_SS_SCALE(n) * stride + s];
+		outputs[2 * stride + s] = cost * inputs[INPUT_COST_SCALE(n) * stride + s];
+		outputs[3 * stride + s] = max(0.0, cost - ensemble.budget[s]);
+	}
+
+	return rechecked;
+}
+
+void scenario_from_inputs(const PortfolioModel& model, const double* inputs, int nScenarios, int s,
+		Scenario& scenario) {
+	const int n = model.nPrograms;
+	const size_t stride = nScenarios;
+
+	scenario.uncertainty.resize(n);
+	for (int progIdx = 0; progIdx < n; progIdx++)
+		scenario.uncertainty[progIdx] = inputs[progIdx * stride + s];
+
+	scenario.bauScale = inputs[INPUT_BAU_SCALE(n) * stride + s];
+	scenario.ssScale = inputs[INPUT_SS_SCALE(n) * stride + s];
+	scenario.costScale = inputs[INPUT_COST_SCALE(n) * stride + s];
+	scenario.budgetScale = inputs[INPUT_BUDGET_SCALE(n) * stride + s];
+}
+
+static inline v4df vmin4(const v4df& a, const v4df& b) {
+	return a < b ? a : b;
+}
+
+static inline v4df vmax4(const v4df& a, const v4df& b) {
+	return a < b ? b : a;
+}
+
+void ensemble_bounds(const PortfolioModel& model, const double* inputs, int nScenarios,
+		double* ideal, double* nadir) {
+	const int n = model.nPrograms;
+	const size_t stride = nScenarios;
+
+	/* the lowest and highest value of each column over a program's options */
+	vector<double> low((size_t)n * nColumns), high((size_t)n * nColumns);
+	for (int progIdx = 0; progIdx < n; progIdx++) {
+		for (int c = 0; c < nColumns; c++) {
+			double lo = model.row(progIdx, 0)[c], hi = lo;
+
+			for (int optIdx = 1; optIdx < model.options(progIdx); optIdx++) {
+				lo = min(lo, model.row(progIdx, optIdx)[c]);
+				hi = max(hi, model.row(progIdx, optIdx)[c]);
+			}
+
+			low[progIdx * nColumns + c] = lo;
+			high[progIdx * nColumns + c] = hi;
+		}
+	}
+
+	/* a negative multiplier or scale swaps which end is best */
+	const v4df zero = { 0.0, 0.0, 0.0, 0.0 };
+	int s = 0;
+
+	for (; s + SIMD_WIDTH <= nScenarios; s += SIMD_WIDTH) {
+		v4df best[nColumns] = { zero, zero, zero };
+		v4df worst[nColumns] = { zero, zero, zero };
+
+		for (int progIdx = 0; progIdx < n; progIdx++) {
+			v4df u = load4(inputs + progIdx * stride + s);
+
+			for (int c = 0; c < nColumns; c++) {
+				v4df a = u * low[progIdx * nColumns + c];
+				v4df b = u * high[progIdx * nColumns + c];
+				best[c] += vmin4(a, b);
+				worst[c] += vmax4(a, b);
+			}
+		}
+
+		for (int c = 0; c < nColumns; c++) {
+			v4df scale = load4(inputs + (INPUT_BAU_SCALE(n) + c) * stride + s);
+			v4df a = best[c] * scale;
+			v4df b = worst[c] * scale;
+			store4(ideal + c * stride + s, vmin4(a, b));
+			store4(nadir + c * stride + s, vmax4(a, b));
+		}
+	}
+
+	for (; s < nScenarios; s++) {
+		for (int c = 0; c < nColumns; c++) {
+			double best = 0, worst = 0;
+
+			for (int progIdx = 0; progIdx < n; progIdx++) {
+				double u = inputs[progIdx * stride + s];
+				double a = u * low[progIdx * nColumns + c];
+				double b = u * high[progIdx * nColumns + c];
+				best += min(a, b);
+				worst += max(a, b);
+			}
+
+			double scale = inputs[(INPUT_BAU_SCALE(n) + c) * stride + s];
+			ideal[c * stride + s] = min(best * scale, worst * scale);
+			nadir[c * stride + s] = max(best * scale, worst * scale);
+		}
+	}
+}
+
+void load_scenarios(const char* filename, const PortfolioModel& model, vector<double>& inputs,
+		int& nScenarios) {
+	const int n = model.nPrograms;
+	ifstream in(filename);
+	vector<double> rows; // scenario by scenario, all inputs
+	string line;
+
+	if (!in.is_open()) {
+		fprintf(stderr, "Error opening scenario file %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	for (int lineNo = 1; getline(in, line); lineNo++) {
+		istringstream fields(line);
+		vector<double> row;
+		double value;
+
+		while (fields >> value)
+			row.push_back(value);
+		if (row.empty()) continue;
+
+		if ((int)row.size() != n && (int)row.size() != SCENARIO_INPUTS(n)) {
+			fprintf(stderr, "%s: line %d has %d values, expected %d or %d\n", filename, lineNo,
+					(int)row.size(), n, SCENARIO_INPUTS(n));
+			exit(EXIT_FAILURE);
+		}
+
+		row.resize(SCENARIO_INPUTS(n), 1.0);
+		rows.insert(rows.end(), row.begin(), row.end());
+	}
+
+	nScenarios = (int)(rows.size() / SCENARIO_INPUTS(n));
+	inputs.resize(rows.size());
+
+	for (int s = 0; s < nScenarios; s++)
+		for (int i = 0; i < SCENARIO_INPUTS(n); i++)
+			inputs[(size_t)i * nScenarios + s] = rows[(size_t)s * SCENARIO_INPUTS(n) + i];
+}
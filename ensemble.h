@@ -0,0 +1,82 @@
+/*
+ * ensemble.h
+ *
+ *  Evaluation of one portfolio over an ensemble of scenarios.  A scenario is
+ *  described by SCENARIO_INPUTS(nPrograms) inputs: the uncertainty multiplier
+ *  of every program followed by the bau, ss, cost and budget scales.  Inputs
+ *  are stored input by input (input i of scenario s at i*nScenarios + s) and
+ *  the kernel works on SIMD_WIDTH scenarios at a time, accumulating each
+ *  scenario's sums in program order, so every output is identical to what
+ *  portfolio_problem gives for that scenario.
+ */
+
+#ifndef ENSEMBLE_H_
+#define ENSEMBLE_H_
+
+#include <vector>
+#include "placement.h"
+#include "portfolio.h"
+
+#define SCENARIO_INPUTS(nPrograms) ((nPrograms) + 4)
+#define INPUT_BAU_SCALE(nPrograms) ((nPrograms) + 0)
+#define INPUT_SS_SCALE(nPrograms) ((nPrograms) + 1)
+#define INPUT_COST_SCALE(nPrograms) ((nPrograms) + 2)
+#define INPUT_BUDGET_SCALE(nPrograms) ((nPrograms) + 3)
+
+#define ENSEMBLE_OUTPUTS 4 // the 3 objectives and the total budget constraint
+
+// Reads scenarios, one per line, holding either the multiplier of every
+// program or the multipliers followed by the four scales (which otherwise
+// default to 1).  Exits on malformed input.
+void load_scenarios(const char* filename, const PortfolioModel& model, std::vector<double>& inputs,
+		int& nScenarios);
+
+// Sets a scenario from the inputs of scenario s of nScenarios.
+void scenario_from_inputs(const PortfolioModel& model, const double* inputs, int nScenarios, int s,
+		Scenario& scenario);
+
+// Writes output o of scenario s to outputs[o*nScenarios + s] for the
+// portfolio given by one option index per program.
+void evaluate_ensemble(const PortfolioModel& model, const int* opts, const double* inputs, int nScenarios,
+		double* outputs);
+
+// The outputs of scenario s alone, identical to those evaluate_ensemble
+// writes for it.
+void evaluate_ensemble_scenario(const PortfolioModel& model, const int* opts, const double* inputs,
+		int nScenarios, int s, double* outputs);
+
+// An ensemble and the model rounded to single precision, for the float
+// kernel, with a bound on how far each of its sums can be from the double
+// one: (nPrograms + 4) * FLT_EPSILON times the sum of every program's
+// largest absolute contribution in that scenario.  The bound covers the
+// rounding of the inputs, the rows and every product and addition in float,
+// and that of the double path itself.
+struct FloatEnsemble {
+	int nScenarios;
+	SharedBuffer<float> inputs;     // the multipliers, as in the double inputs
+	SharedBuffer<float> rows;       // the model's option rows
+	SharedBuffer<double> error;     // bound on each unscaled sum, [c*nScenarios + s]
+	SharedBuffer<double> budget;    // cost threshold * budget scale per scenario
+};
+
+void init_float_ensemble(FloatEnsemble& ensemble, const PortfolioModel& model, const double* inputs,
+		int nScenarios);
+
+// evaluate_ensemble in single precision, FLOAT_WIDTH scenarios at a time.
+// Objectives are within the error bound (times the scale) of the double
+// path's.  Scenarios whose cost is within the bound of the budget are
+// evaluated again in double, so the budget constraint is exactly the double
+// path's wherever feasibility is in doubt, and elsewhere agrees on it.
+// Returns the number of scenarios evaluated again.
+int evaluate_ensemble_float(const FloatEnsemble& ensemble, const PortfolioModel& model, const int* opts,
+		const double* inputs, double* outputs);
+
+// Writes the ideal and nadir value of each objective in each scenario, at
+// [c*nScenarios + s].  The objectives being sums over programs, the ideal is
+// the sum of every program's best option and the nadir that of its worst, so
+// they bound the objectives of every portfolio, feasible or not.  One pass
+// over the programs, vectorized across scenarios.
+void ensemble_bounds(const PortfolioModel& model, const double* inputs, int nScenarios,
+		double* ideal, double* nadir);
+
+#endif /* ENSEMBLE_H_ */
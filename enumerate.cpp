@@ -0,0 +1,120 @@
+/* enumerate.cpp
+ Depth-first enumeration of portfolios with incrementally maintained sums.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "enumerate.h"
+
+using namespace std;
+
+// A program listed twice would be enumerated twice and its row added twice.
+static void check_free_programs(const ScenarioTable& table, const int* freePrograms, int nFree) {
+	vector<bool> isFree(table.nPrograms, false);
+
+	for (int i = 0; i < nFree; i++) {
+		if (freePrograms[i] < 0 || freePrograms[i] >= table.nPrograms) {
+			fprintf(stderr, "Free program %d is not in the model\n", freePrograms[i] + 1);
+			exit(EXIT_FAILURE);
+		}
+
+		if (isFree[freePrograms[i]]) {
+			fprintf(stderr, "Free program %d is listed twice\n", freePrograms[i] + 1);
+			exit(EXIT_FAILURE);
+		}
+		isFree[freePrograms[i]] = true;
+	}
+}
+
+uint64_t count_portfolios(const ScenarioTable& table, const int* freePrograms, int nFree) {
+	uint64_t count = 1;
+
+	check_free_programs(table, freePrograms, nFree);
+
+	for (int i = 0; i < nFree; i++) {
+		uint64_t options = table.options(freePrograms[i]);
+		if (count > UINT64_MAX / options) return UINT64_MAX;
+		count *= options;
+	}
+
+	return count;
+}
+
+uint64_t enumerate_portfolios(const ScenarioTable& table, const int* base,
+		const int* freePrograms, int nFree, EnumerateCallback callback, void* context) {
+	vector<int> opts(base, base + table.nPrograms);
+	const int stride = table.yearStride;
+	vector<double> partial((nFree + 1) * nColumns, 0.0); // sums above each search level
+	vector<double> partialYears((nFree + 1) * stride, 0.0);
+	vector<int> level(nFree, 0);                        // option being tried at each level
+	double objs[nColumns];
+	double consts[1 + MAX_YEARS];
+	uint64_t visited = 0;
+
+	check_free_programs(table, freePrograms, nFree);
+
+	/* level 0 holds the sums over the fixed programs */
+	vector<bool> isFree(table.nPrograms, false);
+	for (int i = 0; i < nFree; i++)
+		isFree[freePrograms[i]] = true;
+
+	for (int progIdx = 0; progIdx < table.nPrograms; progIdx++) {
+		if (isFree[progIdx]) continue;
+
+		const double* row = table.row(progIdx, opts[progIdx]);
+		for (int c = 0; c < nColumns; c++)
+			partial[c] += row[c];
+
+		for (int y = 0; y < table.nYears; y++)
+			partialYears[y] += table.yearRow(progIdx, opts[progIdx])[y];
+	}
+
+	int depth = 0;
+	while (depth >= 0) {
+		if (depth == nFree) {
+			const double* sums = &partial[nFree * nColumns];
+
+			for (int c = 0; c < nColumns; c++)
+				objs[c] = sums[c] * table.scale[c];
+			consts[0] = max(0.0, sums[COL_COST] - table.budget);
+
+			const double* yearSums = &partialYears[nFree * stride];
+			for (int y = 0; y < table.nYears; y++)
+				consts[1 + y] = max(0.0, yearSums[y] - table.yearBudget[y]);
+			visited++;
+
+			if (!callback(&opts[0], objs, consts, context)) break;
+			depth--;
+			continue;
+		}
+
+		int progIdx = freePrograms[depth];
+		if (level[depth] == table.options(progIdx)) {
+			level[depth] = 0;
+			depth--;
+			continue;
+		}
+
+		/* descend with the next option of this program */
+		const double* row = table.row(progIdx, level[depth]);
+		const double* above = &partial[depth * nColumns];
+		double* below = &partial[(depth + 1) * nColumns];
+		for (int c = 0; c < nColumns; c++)
+			below[c] = above[c] + row[c];
+
+		if (stride > 0) {
+			const double* yearRow = table.yearRow(progIdx, level[depth]);
+			const double* yearsAbove = &partialYears[depth * stride];
+			double* yearsBelow = &partialYears[(depth + 1) * stride];
+			for (int v = 0; v < stride; v += SIMD_WIDTH)
+				store4(yearsBelow + v, load4(yearsAbove + v) + load4(yearRow + v));
+		}
+
+		opts[progIdx] = level[depth]++;
+		depth++;
+	}
+
+	return visited;
+}
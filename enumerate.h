@@ -0,0 +1,30 @@
+/*
+ * enumerate.h
+ *
+ *  Exhaustive enumeration of portfolios over a subset of programs.  The
+ *  remaining programs stay at the options of a base portfolio.  Sums are
+ *  updated incrementally as the search moves between neighbouring
+ *  portfolios, so each visited portfolio costs a handful of additions rather
+ *  than a full evaluation; results may therefore differ from
+ *  evaluate_options in the last bits.
+ */
+
+#ifndef ENUMERATE_H_
+#define ENUMERATE_H_
+
+#include <stdint.h>
+#include "portfolio.h"
+
+// Invoked for every enumerated portfolio; return false to stop the search.
+typedef bool (*EnumerateCallback)(const int* opts, const double* objs, const double* consts, void* context);
+
+// Number of portfolios enumerate_portfolios would visit, saturating at UINT64_MAX.
+// Both exit if a free program is out of range or listed twice.
+uint64_t count_portfolios(const ScenarioTable& table, const int* freePrograms, int nFree);
+
+// Visits every combination of options for the free programs, with all other
+// programs fixed at their option in base.  Returns the number visited.
+uint64_t enumerate_portfolios(const ScenarioTable& table, const int* base,
+		const int* freePrograms, int nFree, EnumerateCallback callback, void* context);
+
+#endif /* ENUMERATE_H_ */
@@ -0,0 +1,292 @@
+/* fixedpoint.cpp
+ Exact fixed-point evaluation, one integer lane per solution.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include "fixedpoint.h"
+#include "simd.h"
+
+using namespace std;
+
+struct FixedJob {
+	const FixedTable* table;
+	const uint8_t* opts;
+	int nSolutions;
+	double* objs;
+	double* consts;
+};
+
+// The integer for a value scaled by scale, if scaling recovers it exactly.
+static bool to_fixed(double value, int scale, int64_t& fixed) {
+	double scaled = round(value * scale);
+	if (fabs(scaled) > INT_MAX) return false;
+
+	fixed = (int64_t)scaled;
+	return (double)fixed / scale == value;
+}
+
+bool build_fixed_table(const PortfolioModel& model, const Scenario& scenario, FixedTable& table,
+		const char** why) {
+	const int scales[nColumns] = { 1, 1, FIXED_COST_SCALE };
+
+	if (model.nYears > 0) {
+		*why = "the model has yearly budgets";
+		return false;
+	}
+
+	for (int progIdx = 1; progIdx < model.nPrograms; progIdx++) {
+		if (scenario.uncertainty[progIdx] != scenario.uncertainty[0]) {
+			*why = "the programs have different uncertainty multipliers";
+			return false;
+		}
+	}
+
+	table.nPrograms = model.nPrograms;
+	table.offsets.assign(model.offsets, model.offsets + model.nPrograms + 1);
+	for (int c = 0; c < nColumns; c++)
+		table.columns[c].assign(model.nRows + FIXED_PAD, 0);
+	table.costs.resize(model.nRows);
+
+	/* largest magnitude any sum can reach, to rule out overflow */
+	int64_t bound[nColumns] = { 0, 0, 0 };
+
+	for (int progIdx = 0; progIdx < model.nPrograms; progIdx++) {
+		int64_t largest[nColumns] = { 0, 0, 0 };
+
+		for (int optIdx = 0; optIdx < model.options(progIdx); optIdx++) {
+			const double* src = model.row(progIdx, optIdx);
+			const int row = model.offsets[progIdx] + optIdx;
+
+			for (int c = 0; c < nColumns; c++) {
+				int64_t fixed;
+				if (!to_fixed(src[c], scales[c], fixed)) {
+					*why = c == COL_COST ? "a cost has more than three decimals" : "a bau or ss value is not an integer";
+					return false;
+				}
+
+				table.columns[c][row] = (int32_t)fixed;
+				largest[c] = max(largest[c], fixed < 0 ? -fixed : fixed);
+			}
+
+			table.costs[row] = scenario.uncertainty[progIdx] * src[COL_COST];
+		}
+
+		for (int c = 0; c < nColumns; c++)
+			bound[c] += largest[c];
+	}
+
+	for (int c = 0; c < nColumns; c++) {
+		if (bound[c] > INT_MAX) {
+			*why = "the sums could overflow 32 bits";
+			return false;
+		}
+	}
+
+	table.uncertainty = model.nPrograms > 0 ? scenario.uncertainty[0] : 1.0;
+	table.scale[COL_BAU] = scenario.bauScale;
+	table.scale[COL_SS] = scenario.ssScale;
+	table.scale[COL_COST] = scenario.costScale;
+	table.budget = model.costThreshold * scenario.budgetScale;
+
+	/* the model's costs are within half an ulp of the integers over
+	 * FIXED_COST_SCALE, and the double paths round each product and addition */
+	table.costError = (2.0 * model.nPrograms + 4) * DBL_EPSILON * fabs(table.uncertainty)
+			* bound[COL_COST] / FIXED_COST_SCALE;
+	return true;
+}
+
+// The entries of a program's column at the options in index, for any number
+// of options: the column is shuffled one vector at a time.
+template <typename V>
+SIMD_KERNEL V lookup(const int32_t* column, V index, int nOptions) {
+	const int W = sizeof(V) / sizeof(int32_t);
+	V values = __builtin_shuffle(loadv<V>(column), index);
+
+	for (int first = W; first < nOptions; first += W)
+		values = index >= first ? __builtin_shuffle(loadv<V>(column + first), index - first) : values;
+
+	return values;
+}
+
+// SSE2 has no variable shuffle of 32-bit lanes: four loads are cheaper.
+SIMD_KERNEL v4si lookup(const int32_t* column, v4si index, int nOptions) {
+	return v4si { column[index[0]], column[index[1]], column[index[2]], column[index[3]] };
+}
+
+// Interleaves the low halves of a and b into a and the high halves into b,
+// in elements of 1, 2, 4 and 8 bytes.  Every level has these as unpack
+// instructions.
+
+SIMD_KERNEL void interleave8(v16qu& a, v16qu& b) {
+	v16qu low = __builtin_shuffle(a, b, v16qi { 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23 });
+	b = __builtin_shuffle(a, b, v16qi { 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31 });
+	a = low;
+}
+
+SIMD_KERNEL void interleave16(v16qu& a, v16qu& b) {
+	v8hi x = (v8hi)a, y = (v8hi)b;
+	a = (v16qu)__builtin_shuffle(x, y, v8hi { 0, 8, 1, 9, 2, 10, 3, 11 });
+	b = (v16qu)__builtin_shuffle(x, y, v8hi { 4, 12, 5, 13, 6, 14, 7, 15 });
+}
+
+SIMD_KERNEL void interleave32(v16qu& a, v16qu& b) {
+	v4si x = (v4si)a, y = (v4si)b;
+	a = (v16qu)__builtin_shuffle(x, y, v4si { 0, 4, 1, 5 });
+	b = (v16qu)__builtin_shuffle(x, y, v4si { 2, 6, 3, 7 });
+}
+
+SIMD_KERNEL void interleave64(v16qu& a, v16qu& b) {
+	v2di x = (v2di)a, y = (v2di)b;
+	a = (v16qu)__builtin_shuffle(x, y, v2di { 0, 2 });
+	b = (v16qu)__builtin_shuffle(x, y, v2di { 1, 3 });
+}
+
+// Transposes FIXED_GROUP solutions by FIXED_GROUP programs of options in
+// four rounds of interleaves.  Row j of the result holds, for each
+// solution, the option of program reversed[j] (bit-reversed j).
+SIMD_KERNEL void transpose(v16qu* rows) {
+	for (int i = 0; i < FIXED_GROUP; i += 2)
+		interleave8(rows[i], rows[i + 1]);
+	for (int i = 0; i < FIXED_GROUP; i += 4)
+		for (int k = i; k < i + 2; k++)
+			interleave16(rows[k], rows[k + 2]);
+	for (int i = 0; i < FIXED_GROUP; i += 8)
+		for (int k = i; k < i + 4; k++)
+			interleave32(rows[k], rows[k + 4]);
+	for (int k = 0; k < 8; k++)
+		interleave64(rows[k], rows[k + 8]);
+}
+
+// Widens a transposed row of options to FIXED_GROUP 32-bit lanes.  With
+// shuffles rather than __builtin_convertvector, which GCC splits into scalar
+// moves when optimizing the kernel body before a SIMD_TARGET wrapper inlines
+// it.
+SIMD_KERNEL void widen(v16qu bytes, int32_t* index) {
+	v16qu high = {}, mid = {}, top = {};
+
+	interleave8(bytes, high);
+	interleave16(bytes, mid);
+	interleave16(high, top);
+
+	storev(index, bytes);
+	storev(index + 4, mid);
+	storev(index + 8, high);
+	storev(index + 12, top);
+}
+
+static const int reversed[FIXED_GROUP] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+template <typename V>
+SIMD_KERNEL void fixed_kernel(const FixedJob* job, int task) {
+	const int W = sizeof(V) / sizeof(int32_t);
+	const int nParts = FIXED_GROUP / W;
+	const FixedTable& table = *job->table;
+	const int32_t* bauColumn = &table.columns[COL_BAU][0];
+	const int32_t* ssColumn = &table.columns[COL_SS][0];
+	const int32_t* costColumn = &table.columns[COL_COST][0];
+	const int nPrograms = table.nPrograms;
+	const int first = task * FIXED_TASK;
+	const int last = min(job->nSolutions, first + FIXED_TASK);
+	int32_t index[FIXED_BLOCK][FIXED_GROUP];
+
+	for (int s = first; s < last; s += FIXED_GROUP) {
+		const int lanes = min(FIXED_GROUP, last - s);
+		const uint8_t* sols[FIXED_GROUP];
+		V sums[nColumns][nParts] = {};
+
+		/* lanes past the last solution repeat it */
+		for (int k = 0; k < FIXED_GROUP; k++)
+			sols[k] = job->opts + (size_t)(s + min(k, lanes - 1)) * nPrograms;
+
+		for (int b0 = 0; b0 < nPrograms; b0 += FIXED_BLOCK) {
+			const int b1 = min(nPrograms, b0 + FIXED_BLOCK);
+
+			/* the block's options, transposed to one row of lanes per
+			 * program, then the sums over those rows */
+			for (int p0 = b0; p0 < b1; p0 += FIXED_GROUP) {
+				/* a short last group is read as the last FIXED_GROUP
+				 * programs, skipping those already transposed */
+				const int start = max(0, min(p0, nPrograms - FIXED_GROUP));
+				v16qu rows[FIXED_GROUP];
+
+				for (int k = 0; k < FIXED_GROUP; k++) {
+					if (start + FIXED_GROUP <= nPrograms) {
+						rows[k] = loadv<v16qu>(sols[k] + start);
+					} else {
+						rows[k] = v16qu {};
+						memcpy(&rows[k], sols[k], nPrograms);
+					}
+				}
+
+				transpose(rows);
+				for (int j = 0; j < FIXED_GROUP; j++) {
+					const int progIdx = start + reversed[j];
+					if (progIdx >= p0 && progIdx < b1)
+						widen(rows[j], index[progIdx - b0]);
+				}
+			}
+
+			for (int progIdx = b0; progIdx < b1; progIdx++) {
+				const int row = table.offsets[progIdx];
+				const int nOptions = table.options(progIdx);
+
+				for (int part = 0; part < nParts; part++) {
+					const V options = loadv<V>(index[progIdx - b0] + part * W);
+					sums[COL_BAU][part] += lookup(bauColumn + row, options, nOptions);
+					sums[COL_SS][part] += lookup(ssColumn + row, options, nOptions);
+					sums[COL_COST][part] += lookup(costColumn + row, options, nOptions);
+				}
+			}
+		}
+
+		for (int k = 0; k < lanes; k++) {
+			double cost = (double)sums[COL_COST][k / W][k % W] / FIXED_COST_SCALE * table.uncertainty;
+			double* objs = job->objs + (size_t)(s + k) * nColumns;
+
+			/* too close to call: the double paths' sum, in program order */
+			if (fabs(cost - table.budget) <= table.costError) {
+				cost = 0;
+				for (int progIdx = 0; progIdx < nPrograms; progIdx++)
+					cost += table.costs[table.offsets[progIdx] + sols[k][progIdx]];
+			}
+
+			objs[0] = (double)sums[COL_BAU][k / W][k % W] * table.uncertainty * table.scale[COL_BAU];
+			objs[1] = (double)sums[COL_SS][k / W][k % W] * table.uncertainty * table.scale[COL_SS];
+			objs[2] = cost * table.scale[COL_COST];
+			job->consts[s + k] = max(0.0, cost - table.budget);
+		}
+	}
+}
+
+static void fixed_sse2(const FixedJob* job, int task) {
+	fixed_kernel<v4si>(job, task);
+}
+
+SIMD_TARGET_AVX2 static void fixed_avx2(const FixedJob* job, int task) {
+	fixed_kernel<v8si>(job, task);
+}
+
+SIMD_TARGET_AVX512 static void fixed_avx512(const FixedJob* job, int task) {
+	fixed_kernel<v16si>(job, task);
+}
+
+static void fixed_task(int task, int worker, void* context) {
+	SIMD_DISPATCH(fixed, ((const FixedJob*)context, task));
+}
+
+void evaluate_fixed(const FixedTable& table, const uint8_t* opts, int nSolutions, double* objs, double* consts,
+		ThreadPool* pool) {
+	const int nTasks = (nSolutions + FIXED_TASK - 1) / FIXED_TASK;
+	FixedJob job = { &table, opts, nSolutions, objs, consts };
+
+	if (pool != NULL) {
+		pool->run(nTasks, fixed_task, &job);
+	} else {
+		for (int task = 0; task < nTasks; task++)
+			fixed_task(task, 0, &job);
+	}
+}
@@ -0,0 +1,65 @@
+/*
+ * fixedpoint.h
+ *
+ *  Exact evaluation in fixed point.  The bau and ss columns of the built-in
+ *  model are integers and its costs have at most three decimals, so the
+ *  table can hold bau, ss and cost * FIXED_COST_SCALE as 32-bit integers.
+ *  Sums over programs are then exact and independent of order.  They are
+ *  vectorized across solutions, one 32-bit lane per solution, so a v16si at
+ *  SIMD_AVX512 sums sixteen solutions at once (twice the lanes of a v8df);
+ *  each program's column of option values is loaded as one vector and
+ *  indexed by the lanes' options with a shuffle (at SIMD_SSE2, which has
+ *  no such shuffle, with one load per lane).  The common uncertainty
+ *  multiplier and the scales are applied when the sums are converted to
+ *  doubles.
+ *
+ *  This only holds when every program has the same uncertainty multiplier,
+ *  the model has no yearly budgets, every value is representable and no sum
+ *  can overflow; build_fixed_table checks all of this.  The conversion
+ *  rounds bau and ss twice (multiplier, scale) and cost three times
+ *  (FIXED_COST_SCALE, multiplier, scale), where the double paths round at
+ *  every addition, so results can differ from theirs in the last bits.  A
+ *  cost within costError of the budget is summed again the double paths'
+ *  way, so feasibility always agrees with them.
+ */
+
+#ifndef FIXEDPOINT_H_
+#define FIXEDPOINT_H_
+
+#include <stdint.h>
+#include <vector>
+#include "portfolio.h"
+#include "threadpool.h"
+
+#define FIXED_COST_SCALE 1000 // cost units per integer step
+#define FIXED_PAD 16          // zeros after each column, for full-width loads
+#define FIXED_GROUP 16        // solutions summed together, and programs transposed at once
+#define FIXED_BLOCK 128       // programs whose options are transposed before summing
+#define FIXED_TASK 256        // solutions per task
+
+struct FixedTable {
+	int nPrograms;
+	std::vector<uint32_t> offsets;
+	std::vector<int32_t> columns[nColumns]; // bau, ss and scaled cost of every option row
+	std::vector<double> costs;    // uncertainty * cost of every option row, as in ScenarioTable
+	double uncertainty;           // the multiplier common to every program
+	double scale[nColumns];
+	double budget;                // cost threshold * budget scale
+	double costError;             // bound on the gap between the cost and the double paths'
+
+	int options(int progIdx) const {
+		return offsets[progIdx + 1] - offsets[progIdx];
+	}
+};
+
+// Builds the fixed-point table of a scenario.  Returns false, with the reason
+// in why, if the model or scenario cannot be evaluated exactly.
+bool build_fixed_table(const PortfolioModel& model, const Scenario& scenario, FixedTable& table,
+		const char** why);
+
+// Evaluates nSolutions portfolios given as rows of option indices, writing
+// nColumns objectives and one constraint per solution.  The pool may be NULL.
+void evaluate_fixed(const FixedTable& table, const uint8_t* opts, int nSolutions, double* objs, double* consts,
+		ThreadPool* pool);
+
+#endif /* FIXEDPOINT_H_ */
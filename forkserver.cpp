@@ -0,0 +1,177 @@
+/* forkserver.cpp
+ Unix socket fork server passing the standard streams with SCM_RIGHTS.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "forkserver.h"
+
+#define FORK_STREAMS 3 // stdin, stdout and stderr
+
+void touch_pages(const void* data, size_t size) {
+	const volatile char* bytes = (const volatile char*)data;
+	long pageSize = sysconf(_SC_PAGESIZE);
+
+	for (size_t offset = 0; offset < size; offset += pageSize)
+		(void)bytes[offset];
+}
+
+static void socket_address(const char* path, struct sockaddr_un& address) {
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(address.sun_path, path);
+}
+
+// Receives the client's streams; false if the client sent something else.
+static bool receive_streams(int conn, int* fds) {
+	char byte;
+	struct iovec iov = { &byte, 1 };
+	union {
+		struct cmsghdr header;
+		char space[CMSG_SPACE(FORK_STREAMS * sizeof(int))];
+	} control;
+	struct msghdr message;
+
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control.space;
+	message.msg_controllen = sizeof(control.space);
+
+	if (recvmsg(conn, &message, 0) != 1) return false;
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+	if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+			cmsg->cmsg_len != CMSG_LEN(FORK_STREAMS * sizeof(int)))
+		return false;
+
+	memcpy(fds, CMSG_DATA(cmsg), FORK_STREAMS * sizeof(int));
+	return true;
+}
+
+void serve_forks(const char* path) {
+	struct sockaddr_un address;
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	socket_address(path, address);
+	unlink(path);
+
+	if (listener < 0 || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+			listen(listener, 64) != 0) {
+		fprintf(stderr, "Unable to listen on %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	signal(SIGCHLD, SIG_IGN); // monitors are reaped automatically
+	fflush(NULL);
+	fprintf(stderr, "Fork server listening on %s\n", path);
+
+	for (;;) {
+		int conn = accept(listener, NULL, NULL);
+		int fds[FORK_STREAMS];
+
+		if (conn < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr, "accept: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		if (!receive_streams(conn, fds)) {
+			close(conn);
+			continue;
+		}
+
+		/* a monitor process forks the evaluator, waits for it and reports
+		 * its exit status to the client */
+		pid_t monitor = fork();
+
+		if (monitor == 0) {
+			close(listener);
+			signal(SIGCHLD, SIG_DFL);
+
+			pid_t child = fork();
+			if (child == 0) {
+				close(conn);
+				for (int i = 0; i < FORK_STREAMS; i++) {
+					dup2(fds[i], i);
+					close(fds[i]);
+				}
+				return;
+			}
+
+			for (int i = 0; i < FORK_STREAMS; i++)
+				close(fds[i]);
+
+			int status = 0, code = EXIT_FAILURE;
+			if (child > 0 && waitpid(child, &status, 0) == child)
+				code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+			ssize_t written = write(conn, &code, sizeof(code));
+			(void)written;
+			_exit(0);
+		}
+
+		close(conn);
+		for (int i = 0; i < FORK_STREAMS; i++)
+			close(fds[i]);
+	}
+}
+
+int fork_client(const char* path) {
+	struct sockaddr_un address;
+	int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	socket_address(path, address);
+	if (conn < 0 || connect(conn, (struct sockaddr*)&address, sizeof(address)) != 0) {
+		fprintf(stderr, "Unable to connect to %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	int fds[FORK_STREAMS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+	char byte = 0;
+	struct iovec iov = { &byte, 1 };
+	union {
+		struct cmsghdr header;
+		char space[CMSG_SPACE(FORK_STREAMS * sizeof(int))];
+	} control;
+	struct msghdr message;
+
+	memset(&message, 0, sizeof(message));
+	memset(&control, 0, sizeof(control));
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control.space;
+	message.msg_controllen = sizeof(control.space);
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(FORK_STREAMS * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	if (sendmsg(conn, &message, 0) != 1) {
+		fprintf(stderr, "Unable to pass streams to %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	int code;
+	if (read(conn, &code, sizeof(code)) != (ssize_t)sizeof(code)) {
+		fprintf(stderr, "Fork server closed the connection\n");
+		exit(EXIT_FAILURE);
+	}
+
+	close(conn);
+	return code;
+}
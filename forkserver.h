@@ -0,0 +1,31 @@
+/*
+ * forkserver.h
+ *
+ *  Fork-server mode.  After the model is loaded and the scenario tables are
+ *  built, the process listens on a Unix socket instead of evaluating.  Each
+ *  client (tools/forkclient.exe) passes its stdin, stdout and stderr over the
+ *  socket; the server forks a child that takes them over and carries on as a
+ *  freshly started evaluator, with the tables already in memory.  The client
+ *  exits with the child's exit status, so to the program that spawned it the
+ *  client behaves like portfolio.exe itself.
+ */
+
+#ifndef FORKSERVER_H_
+#define FORKSERVER_H_
+
+#include <stddef.h>
+
+// Touches every page of the given memory, so that forked children share
+// pages that are already mapped.
+void touch_pages(const void* data, size_t size);
+
+// Serves clients on the Unix socket at path.  Returns only in a forked
+// child, with the client's descriptors as its standard streams; the server
+// itself runs until killed.
+void serve_forks(const char* path);
+
+// Connects to a fork server, hands it the standard streams and returns the
+// exit status of the child serving them.  Exits on connection errors.
+int fork_client(const char* path);
+
+#endif /* FORKSERVER_H_ */
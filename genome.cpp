@@ -0,0 +1,86 @@
+/* genome.cpp
+ Packing of portfolio genomes into option-width bit fields.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "genome.h"
+
+using namespace std;
+
+void build_genome_layout(const PortfolioModel& model, GenomeLayout& layout) {
+	uint32_t pos = 0;
+
+	layout.nPrograms = model.nPrograms;
+	layout.bitOffset.resize(model.nPrograms);
+	layout.bits.resize(model.nPrograms);
+	layout.options.resize(model.nPrograms);
+
+	for (int progIdx = 0; progIdx < model.nPrograms; progIdx++) {
+		int width = 0;
+		while ((1 << width) < model.options(progIdx))
+			width++;
+
+		layout.bitOffset[progIdx] = pos;
+		layout.bits[progIdx] = width;
+		layout.options[progIdx] = model.options(progIdx);
+		pos += width;
+	}
+
+	layout.nWords = max(1, (int)((pos + 63) / 64));
+}
+
+void pack_genome(const GenomeLayout& layout, const int* opts, uint64_t* words) {
+	memset(words, 0, layout.nWords * sizeof(uint64_t));
+
+	for (int progIdx = 0; progIdx < layout.nPrograms; progIdx++) {
+		uint32_t pos = layout.bitOffset[progIdx];
+		uint32_t shift = pos & 63;
+		uint64_t value = (uint64_t)opts[progIdx];
+
+		words[pos >> 6] |= value << shift;
+		if (shift + layout.bits[progIdx] > 64)
+			words[(pos >> 6) + 1] |= value >> (64 - shift);
+	}
+}
+
+void unpack_genome(const GenomeLayout& layout, const uint64_t* words, int* opts) {
+	for (int progIdx = 0; progIdx < layout.nPrograms; progIdx++)
+		opts[progIdx] = layout.option(words, progIdx);
+}
+
+void pack_vars(const GenomeLayout& layout, const double* vars, uint64_t* words) {
+	memset(words, 0, layout.nWords * sizeof(uint64_t));
+
+	for (int progIdx = 0; progIdx < layout.nPrograms; progIdx++) {
+		uint32_t pos = layout.bitOffset[progIdx];
+		uint32_t shift = pos & 63;
+		uint64_t value = (uint64_t)option_index(vars[progIdx], layout.options[progIdx]);
+
+		words[pos >> 6] |= value << shift;
+		if (shift + layout.bits[progIdx] > 64)
+			words[(pos >> 6) + 1] |= value >> (64 - shift);
+	}
+}
+
+void evaluate_packed(const ScenarioTable& table, const GenomeLayout& layout, const uint64_t* words,
+		double* objs, double* consts) {
+	double bau = 0, ss = 0, cost = 0;
+
+	for (int progIdx = 0; progIdx < table.nPrograms; progIdx++) {
+		const double* row = table.row(progIdx, layout.option(words, progIdx));
+
+		bau += row[COL_BAU];
+		ss += row[COL_SS];
+		cost += row[COL_COST];
+	}
+
+	objs[0] = bau * table.scale[COL_BAU];
+	objs[1] = ss * table.scale[COL_SS];
+	objs[2] = cost * table.scale[COL_COST];
+
+	consts[0] = max(0.0, cost - table.budget);
+
+	if (table.nYears > 0)
+		year_constraints(table, [&](int progIdx) { return layout.option(words, progIdx); }, consts + 1);
+}
@@ -0,0 +1,48 @@
+/*
+ * genome.h
+ *
+ *  Bit-packed portfolio genomes.  Each program's option index is stored in
+ *  the fewest bits able to hold options(progIdx)-1, so a 22 program model
+ *  with four options per program packs into a single 64-bit word.
+ */
+
+#ifndef GENOME_H_
+#define GENOME_H_
+
+#include <stdint.h>
+#include <vector>
+#include "portfolio.h"
+
+struct GenomeLayout {
+	int nPrograms;
+	int nWords;                      // 64-bit words per packed genome
+	std::vector<uint32_t> bitOffset; // first bit of each program's field
+	std::vector<uint8_t> bits;       // width of each program's field
+	std::vector<uint16_t> options;   // option count of each program
+
+	int option(const uint64_t* words, int progIdx) const {
+		uint32_t pos = bitOffset[progIdx];
+		uint32_t shift = pos & 63;
+		uint64_t value = words[pos >> 6] >> shift;
+
+		if (shift + bits[progIdx] > 64)
+			value |= words[(pos >> 6) + 1] << (64 - shift);
+
+		return (int)(value & ((1ULL << bits[progIdx]) - 1));
+	}
+};
+
+void build_genome_layout(const PortfolioModel& model, GenomeLayout& layout);
+
+void pack_genome(const GenomeLayout& layout, const int* opts, uint64_t* words);
+
+void unpack_genome(const GenomeLayout& layout, const uint64_t* words, int* opts);
+
+// Packs real-valued decision variables, mapping each through option_index.
+void pack_vars(const GenomeLayout& layout, const double* vars, uint64_t* words);
+
+// Evaluates a packed genome against a scenario table built from the same model.
+void evaluate_packed(const ScenarioTable& table, const GenomeLayout& layout, const uint64_t* words,
+		double* objs, double* consts);
+
+#endif /* GENOME_H_ */
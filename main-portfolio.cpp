@@ -7,12 +7,14 @@
 
  Decision Vector
  vars : anthropogenic pollution flow at previous time step - Size 22, Bounds (0.0,<4)
+        (size and bounds follow the model when one is loaded with -M)
 
   */
 
 #include <stdio.h>
 #include <unistd.h>
 #include <sstream>
+#include <string.h>
 #include <boost/numeric/ublas/io.hpp>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/matrix_proxy.hpp>
@@ -20,47 +22,23 @@
 #include <boost/math/tools/roots.hpp>
 #include "moeaframework.h"
 #include "boostutil.h"
-
-#include "modeldfn.h"
-
-#define nPrograms 22
-#define cost_threshold 35000
-
-double bauScale, ssScale, costScale, budgetScale;
-
-int nvars = nPrograms;
-int nobjs = 3;
-int nconsts = 1;
+#include "portfolio.h"
+#include "batch.h"
+#include "montecarlo.h"
+#include "correlate.h"
+#include "regret.h"
+#include "repair.h"
+#include "daemon.h"
+#include "forkserver.h"
+#include "stats.h"
+#include "trace.h"
+#include "fixedpoint.h"
+#include "simd.h"
 
 namespace ublas = boost::numeric::ublas;
 namespace tools = boost::math::tools;
 using namespace std;
 
-void portfolio_problem(double* vars, double* objs, double* consts, double* uncertainty);
-
-void portfolio_problem(double* vars, double* objs, double* consts, double* uncertainty) {
-	double bau = 0, ss = 0, cost = 0;
-	int optIdx; // Option Index
-	vector<int> progOpts;
-	progOpts.assign(vars, vars + nvars);
-
-	for (int progIdx = 0; progIdx < nPrograms; progIdx++) {
-		optIdx = progOpts[progIdx];
-
-		bau += uncertainty[progIdx] * modelmat[4 * progIdx + optIdx][0];
-		ss += uncertainty[progIdx] * modelmat[4 * progIdx + optIdx][1];
-		cost += uncertainty[progIdx] * modelmat[4 * progIdx + optIdx][2];
-
-	}
-
-	// Calculate minimization objectives (defined in comments at beginning of file)
-	objs[0] = bau * bauScale;
-	objs[1] = ss * ssScale;
-	objs[2] = cost * costScale;
-
-	consts[0] = max(0.0, cost - cost_threshold * budgetScale);
-}
-
 //double root_function(double x) {
 //	return pow(x, q) / (1 + pow(x, q)) - b * x;
 //}
@@ -70,10 +48,31 @@ bool root_termination(double min, double max) {
 }
 
 int main(int argc, char* argv[]) {
-	double vars[nvars];
-	double objs[nobjs];
-	double consts[nconsts];
-	double uncertainty[nPrograms];
+	double bauScale, ssScale, costScale, budgetScale;
+	double uncertainty[22];
+	int nUncertain = 0; // highest program index given a multiplier, plus one
+	const char* modelFile = NULL;
+	int maxBatch = 1;
+	int nThreads = 1;
+	bool pinThreads = false;            // pin evaluation threads across NUMA nodes
+	int nSamples = 0;          // Monte Carlo samples of cost growth, 0 for deterministic costs
+	double growthSigma = 0.1;  // log-scale standard deviation of cost growth
+	double growthMean = 1.0;   // expected cost growth
+	double riskTolerance = 0.05; // acceptable probability of exceeding the budget
+	const char* correlationFile = NULL; // correlation of cost growth between programs
+	const char* ensembleFile = NULL;    // scenarios for regret objectives
+	double regretQuantile = 1.0;        // percentile of regret minimized, 1 for the maximum
+	bool singleRegret = false;          // float ensemble kernel for regret
+	bool screen = false;                // constraint-first evaluation of batches
+	bool fixedPoint = false;            // exact integer sums
+	int repairMode = 0;                 // 1 to repair portfolios over budget, 2 to also write them back
+	int daemonCache = 0;                // scenario tables cached in daemon mode, 0 when not a daemon
+	const char* libraryFile = NULL;     // scenarios a daemon request can select by ID
+	const char* forkSocket = NULL;      // Unix socket of the fork server
+	const char* port = NULL;            // TCP port to serve the driver on instead of stdin/stdout
+	double statsInterval = 0;           // seconds between instrumentation summaries, 0 for none
+	const char* statsFile = NULL;       // file the summaries are appended to instead of stderr
+	const char* traceFile = NULL;       // binary trace of every evaluation, for tools/replay.exe
 
 	/* Initialize defaults */
 	//Assume noble intent, polling of DMs is an accurate:
@@ -86,7 +85,7 @@ int main(int argc, char* argv[]) {
 	/* read the command line arguments, if present (for openMORDM) */
 	int opt;
 
-	while ((opt = getopt(argc, argv, "a:b:c:d:e:f:g:h:i:j:k:l:m:n:o:p:q:r:s:t:u:v:w:x:y:z:")) != -1) {
+	while ((opt = getopt(argc, argv, "a:b:c:d:e:f:g:h:i:j:k:l:m:n:o:p:q:r:s:t:u:v:w:x:y:z:M:B:J:S:G:A:K:E:Q:CRLD:X:F:N:I:O:T:PWV:H")) != -1) {
 		switch (opt) {
 		case 'w': //Business as Usual Scale
 			bauScale = atof(optarg);
@@ -102,69 +101,165 @@ int main(int argc, char* argv[]) {
 			break;
 		case 'a': //Uncertainty Multiplier for Program 1
 			uncertainty[0] = atof(optarg);
+			nUncertain = max(nUncertain, 1);
 			break;
 		case 'b': //Uncertainty Multiplier for Program 2
 			uncertainty[1] = atof(optarg);
+			nUncertain = max(nUncertain, 2);
 			break;
 		case 'c': //Uncertainty Multiplier for Program 3
 			uncertainty[2] = atof(optarg);
+			nUncertain = max(nUncertain, 3);
 			break;
 		case 'd': //Uncertainty Multiplier for Program 4
 			uncertainty[3] = atof(optarg);
+			nUncertain = max(nUncertain, 4);
 			break;
 		case 'e': //Uncertainty Multiplier for Program 5
 			uncertainty[4] = atof(optarg);
+			nUncertain = max(nUncertain, 5);
 			break;
 		case 'f': //Uncertainty Multiplier for Program 6
 			uncertainty[5] = atof(optarg);
+			nUncertain = max(nUncertain, 6);
 			break;
 		case 'g': //Uncertainty Multiplier for Program 7
 			uncertainty[6] = atof(optarg);
+			nUncertain = max(nUncertain, 7);
 			break;
 		case 'h': //Uncertainty Multiplier for Program 8
 			uncertainty[7] = atof(optarg);
+			nUncertain = max(nUncertain, 8);
 			break;
 		case 'i': //Uncertainty Multiplier for Program 9
 			uncertainty[8] = atof(optarg);
+			nUncertain = max(nUncertain, 9);
 			break;
 		case 'j': //Uncertainty Multiplier for Program 10
 			uncertainty[9] = atof(optarg);
+			nUncertain = max(nUncertain, 10);
 			break;
 		case 'k': //Uncertainty Multiplier for Program 11
 			uncertainty[10] = atof(optarg);
+			nUncertain = max(nUncertain, 11);
 			break;
 		case 'l': //Uncertainty Multiplier for Program 12
 			uncertainty[11] = atof(optarg);
+			nUncertain = max(nUncertain, 12);
 			break;
 		case 'm': //Uncertainty Multiplier for Program 13
 			uncertainty[12] = atof(optarg);
+			nUncertain = max(nUncertain, 13);
 			break;
 		case 'n': //Uncertainty Multiplier for Program 14
 			uncertainty[13] = atof(optarg);
+			nUncertain = max(nUncertain, 14);
 			break;
 		case 'o': //Uncertainty Multiplier for Program 15
 			uncertainty[14] = atof(optarg);
+			nUncertain = max(nUncertain, 15);
 			break;
 		case 'p': //Uncertainty Multiplier for Program 16
 			uncertainty[15] = atof(optarg);
+			nUncertain = max(nUncertain, 16);
 			break;
 		case 'q': //Uncertainty Multiplier for Program 17
 			uncertainty[16] = atof(optarg);
+			nUncertain = max(nUncertain, 17);
 			break;
 		case 'r': //Uncertainty Multiplier for Program 18
 			uncertainty[17] = atof(optarg);
+			nUncertain = max(nUncertain, 18);
 			break;
 		case 's': //Uncertainty Multiplier for Program 19
 			uncertainty[18] = atof(optarg);
+			nUncertain = max(nUncertain, 19);
 			break;
 		case 't': //Uncertainty Multiplier for Program 20
 			uncertainty[19] = atof(optarg);
+			nUncertain = max(nUncertain, 20);
 			break;
 		case 'u': //Uncertainty Multiplier for Program 21
 			uncertainty[20] = atof(optarg);
+			nUncertain = max(nUncertain, 21);
 			break;
 		case 'v': //Uncertainty Multiplier for Program 22
 			uncertainty[21] = atof(optarg);
+			nUncertain = max(nUncertain, 22);
+			break;
+		case 'M': //Model definition file (defaults to the table in modeldfn.h)
+			modelFile = optarg;
+			break;
+		case 'B': //Maximum number of solutions evaluated together when input is queued
+			maxBatch = max(1, atoi(optarg));
+			break;
+		case 'J': //Evaluation threads for batches, 0 for one per hardware thread
+			nThreads = atoi(optarg) > 0 ? atoi(optarg) : hardware_threads();
+			break;
+		case 'H': //Pin evaluation threads to CPUs, alternating between NUMA nodes
+			pinThreads = true;
+			break;
+		case 'S': //Monte Carlo samples of lognormal cost growth (stochastic cost mode)
+			nSamples = atoi(optarg);
+			break;
+		case 'G': //Cost growth as sigma[,mean]
+			growthSigma = atof(optarg);
+			if (strchr(optarg, ',') != NULL) growthMean = atof(strchr(optarg, ',') + 1);
+			break;
+		case 'A': //Acceptable probability of exceeding the budget in stochastic cost mode
+			riskTolerance = atof(optarg);
+			break;
+		case 'K': //Correlation matrix of cost growth between programs in stochastic cost mode
+			correlationFile = optarg;
+			break;
+		case 'E': //Scenario ensemble; objectives become regret over its scenarios
+			ensembleFile = optarg;
+			break;
+		case 'Q': //Percentile of regret over the ensemble as a fraction, 1 for the maximum
+			regretQuantile = atof(optarg);
+			break;
+		case 'W': //Evaluate the ensemble in float, rechecking in double near the regret written
+			singleRegret = true;
+			break;
+		case 'C': //Constraint-first: skip the objectives of solutions over budget
+			screen = true;
+			break;
+		case 'P': //Exact fixed-point evaluation (uniform uncertainty, three-decimal costs)
+			fixedPoint = true;
+			break;
+		case 'R': //Repair portfolios over budget before evaluating them
+			repairMode = max(repairMode, 1);
+			break;
+		case 'L': //Lamarckian repair: write the repaired variables ahead of each result
+			repairMode = 2;
+			break;
+		case 'D': //Daemon mode: requests may switch scenario; argument is the table cache size
+			daemonCache = max(1, atoi(optarg));
+			break;
+		case 'X': //Scenario library for daemon mode, one scenario per line
+			libraryFile = optarg;
+			break;
+		case 'F': //Fork server: serve tools/forkclient.exe connections on this Unix socket
+			forkSocket = optarg;
+			break;
+		case 'N': //Socket mode: accept one driver connection on this TCP port
+			port = optarg;
+			break;
+		case 'I': //Instrumentation: summary of per-phase timings every this many seconds
+			statsInterval = atof(optarg);
+			break;
+		case 'O': //File for the instrumentation summaries
+			statsFile = optarg;
+			break;
+		case 'T': //Capture: record every evaluation to this binary trace
+			traceFile = optarg;
+			break;
+		case 'V': //Instruction set of the kernels (sse2, avx2, avx512), by default the best supported
+			if (!set_simd_level(optarg)) {
+				fprintf(stderr, "Instruction set %s is unknown or not supported here (best: %s)\n", optarg,
+						simd_level_name(supported_simd_level()));
+				exit(EXIT_FAILURE);
+			}
 			break;
 		case '?':
 		default:
@@ -173,14 +268,272 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
-	MOEA_Init(nobjs, nconsts);
+	PortfolioModel model;
+	Scenario scenario;
+	ScenarioTable table;
+
+	if (modelFile != NULL)
+		load_model(modelFile, model);
+	else
+		builtin_model(model);
+
+	if (nUncertain > model.nPrograms) {
+		fprintf(stderr, "Uncertainty multiplier given for program %d, but the model has %d programs\n",
+				nUncertain, model.nPrograms);
+		exit(EXIT_FAILURE);
+	}
+
+	default_scenario(model, scenario);
+	copy(uncertainty, uncertainty + nUncertain, scenario.uncertainty.begin());
+	scenario.bauScale = bauScale;
+	scenario.ssScale = ssScale;
+	scenario.costScale = costScale;
+	scenario.budgetScale = budgetScale;
+	build_scenario_table(model, scenario, table);
+
+	/* In stochastic cost mode the cost objective and budget constraint use the
+	 * expected cost, and a chance constraint on exceeding the budget is added. */
+	MonteCarlo mc;
+	if (nSamples > 0)
+		init_monte_carlo(mc, model.nPrograms, nSamples, growthSigma, growthMean, 1);
+
+	if (correlationFile != NULL) {
+		if (nSamples == 0) {
+			fprintf(stderr, "A correlation matrix (-K) needs stochastic cost mode (-S)\n");
+			exit(EXIT_FAILURE);
+		}
+
+		ublas::matrix<double> correlation;
+		CorrelatedSampler sampler;
+		vector<double> z((size_t)model.nPrograms * (mc.nSamples / 2));
+
+		load_correlation(correlationFile, model.nPrograms, correlation);
+		init_sampler(sampler, correlation, 1);
+		correlated_normals(sampler, mc.nSamples / 2, &z[0], NULL);
+		set_growth(mc, &z[0]);
+	}
+
+	/* With a scenario ensemble the objectives are the regret against each
+	 * scenario's ideal point; constraints stay those of the nominal scenario. */
+	RegretEnsemble ensemble;
+	if (ensembleFile != NULL) {
+		vector<double> inputs;
+		int nScenarios;
 
-	while (MOEA_Next_solution() == MOEA_SUCCESS) {
-		MOEA_Read_doubles(nvars, vars);
-		portfolio_problem(vars, objs, consts, uncertainty);
-		MOEA_Write(objs, consts);
+		if (nSamples > 0) {
+			fprintf(stderr, "Regret objectives (-E) cannot be combined with stochastic cost mode (-S)\n");
+			exit(EXIT_FAILURE);
+		}
+
+		load_scenarios(ensembleFile, model, inputs, nScenarios);
+		if (nScenarios == 0) {
+			fprintf(stderr, "No scenarios in %s\n", ensembleFile);
+			exit(EXIT_FAILURE);
+		}
+		init_regret(ensemble, model, inputs, nScenarios, regretQuantile, singleRegret);
+	} else if (singleRegret) {
+		fprintf(stderr, "Single-precision regret (-W) needs a scenario ensemble (-E)\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (screen && nSamples > 0) {
+		fprintf(stderr, "Constraint-first evaluation (-C) cannot be combined with stochastic cost mode (-S)\n");
+		exit(EXIT_FAILURE);
+	}
+
+	FixedTable fixed;
+	if (fixedPoint) {
+		const char* why;
+
+		if (nSamples > 0 || ensembleFile != NULL || screen || repairMode > 0 || daemonCache > 0) {
+			fprintf(stderr, "Fixed-point evaluation (-P) cannot be combined with -S, -E, -C, -R, -L or -D\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (!build_fixed_table(model, scenario, fixed, &why)) {
+			fprintf(stderr, "Fixed-point evaluation (-P) is not exact here: %s\n", why);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* The fork server only returns in its children, so every conflict with -F
+	 * must be caught before it starts. */
+	if (port != NULL && forkSocket != NULL) {
+		fprintf(stderr, "Socket mode (-N) cannot be combined with -F\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (daemonCache > 0 && (nSamples > 0 || ensembleFile != NULL || screen || repairMode > 0)) {
+		fprintf(stderr, "Daemon mode (-D) cannot be combined with -S, -E, -C, -R or -L\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Not with -F either: every forked child would truncate the one file. */
+	if (traceFile != NULL && (nSamples > 0 || ensembleFile != NULL || screen || repairMode > 0 || fixedPoint || forkSocket != NULL)) {
+		fprintf(stderr, "Capture (-T) cannot be combined with -S, -E, -C, -R, -L, -P or -F\n");
+		exit(EXIT_FAILURE);
+	}
+
+#ifndef PORTFOLIO_STATS
+	if (statsInterval > 0) {
+		fprintf(stderr, "Built without instrumentation; rebuild with make DEFINES=-DPORTFOLIO_STATS to use -I\n");
+		exit(EXIT_FAILURE);
+	}
+#endif
+
+	RepairTable repair;
+	if (repairMode > 0)
+		build_repair_table(table, repair);
+
+	int nvars = model.nPrograms;
+	int nobjs = 3;
+	int nconsts = table.constraints() + (nSamples > 0 ? 1 : 0);
+	vector<double> vars(nvars);
+	double objs[nobjs];
+	double consts[nconsts];
+
+	/* Everything above is shared with the forked evaluators; the server
+	 * returns here only in a child attached to a client's streams. */
+	if (forkSocket != NULL) {
+		if (model.mapping != NULL)
+			touch_pages(model.mapping, model.mappingSize);
+		touch_pages(&table.rows[0], table.rows.size() * sizeof(double));
+		serve_forks(forkSocket);
+	}
+
+	if (port != NULL)
+		MOEA_Init_socket(nobjs, nconsts, port);
+	else
+		MOEA_Init(nobjs, nconsts);
+
+	if (statsInterval > 0)
+		stats_init(statsInterval, statsFile);
+
+	TraceWriter trace;
+	TraceWriter* capture = NULL;
+	vector<uint8_t> traceOpts(nvars);
+	if (traceFile != NULL) {
+		open_trace(trace, traceFile, model, scenario, nconsts);
+		capture = &trace;
+	}
+
+	if (daemonCache > 0) {
+		vector<double> library;
+		int nLibrary = 0;
+
+		if (libraryFile != NULL)
+			load_scenarios(libraryFile, model, library, nLibrary);
+
+		run_daemon(model, scenario, library, nLibrary, daemonCache, capture);
+		if (capture != NULL)
+			close_trace(trace);
+		stats_finish();
+		MOEA_Terminate();
+		return EXIT_SUCCESS;
+	}
+
+	if (maxBatch == 1 && nSamples == 0 && ensembleFile == NULL && !screen && repairMode == 0 && !fixedPoint) {
+		STATS_START();
+		while (MOEA_Next_solution() == MOEA_SUCCESS) {
+			STATS_LAP(PHASE_READ);
+			MOEA_Read_doubles(nvars, &vars[0]);
+			STATS_LAP(PHASE_PARSE);
+			evaluate_table(table, &vars[0], objs, consts);
+			if (capture != NULL) {
+				decode_options(table, &vars[0], &traceOpts[0]);
+				trace_record(trace, TRACE_SCENARIO_BASE, &traceOpts[0], objs, consts);
+			}
+			STATS_LAP(PHASE_EVALUATE);
+			MOEA_Write_buffered(objs, consts);
+			STATS_LAP(PHASE_FORMAT);
+			MOEA_Flush();
+			STATS_LAP(PHASE_FLUSH);
+			STATS_COUNT(COUNT_SOLUTIONS, 1);
+			STATS_POLL();
+		}
+	} else {
+		/* Gather solutions while more are already queued, so drivers that
+		 * stream many solutions get batched evaluation and one flush per batch,
+		 * while a driver waiting on each result still gets it immediately. */
+		ThreadPool pool(nThreads, pinThreads);
+		vector<uint8_t> batchOpts((size_t)maxBatch * nvars);
+		vector<uint8_t> decodedOpts(repairMode == 2 ? batchOpts.size() : 0);
+		vector<double> batchVars(repairMode == 2 ? batchOpts.size() : 0);
+		vector<double> batchObjs(maxBatch * nobjs);
+		vector<double> batchConsts(maxBatch * table.constraints());
+		vector<double> expected(maxBatch), pExceed(maxBatch);
+		int nBatch = 0;
+		bool more = true;
+
+		STATS_START();
+		while (more) {
+			more = MOEA_Next_solution() == MOEA_SUCCESS;
+			STATS_LAP(PHASE_READ);
+
+			if (more) {
+				MOEA_Read_doubles(nvars, &vars[0]);
+				decode_options(table, &vars[0], &batchOpts[(size_t)nBatch * nvars]);
+				if (repairMode == 2)
+					copy(vars.begin(), vars.end(), &batchVars[(size_t)nBatch * nvars]);
+				nBatch++;
+				STATS_LAP(PHASE_PARSE);
+			}
+
+			if (nBatch > 0 && (!more || nBatch == maxBatch || !MOEA_Input_pending())) {
+				if (repairMode == 2)
+					copy(&batchOpts[0], &batchOpts[(size_t)nBatch * nvars], &decodedOpts[0]);
+				if (repairMode > 0)
+					repair_batch(table, repair, &batchOpts[0], nBatch, &pool);
+
+				if (screen)
+					evaluate_batch_screened(table, &batchOpts[0], nBatch, &batchObjs[0], &batchConsts[0], &pool);
+				else if (fixedPoint)
+					evaluate_fixed(fixed, &batchOpts[0], nBatch, &batchObjs[0], &batchConsts[0], &pool);
+				else
+					evaluate_batch(table, &batchOpts[0], nBatch, &batchObjs[0], &batchConsts[0], &pool);
+				if (nSamples > 0)
+					monte_carlo_costs(mc, table, &batchOpts[0], nBatch, &expected[0], &pExceed[0], &pool);
+				if (ensembleFile != NULL)
+					regret_objectives(ensemble, model, &batchOpts[0], nBatch, &batchObjs[0], &pool);
+				STATS_LAP(PHASE_EVALUATE);
+
+				for (int s = 0; s < nBatch; s++) {
+					copy(&batchObjs[s * nobjs], &batchObjs[(s + 1) * nobjs], objs);
+					copy(&batchConsts[s * table.constraints()], &batchConsts[(s + 1) * table.constraints()], consts);
+
+					if (nSamples > 0) {
+						objs[2] = expected[s] * table.scale[COL_COST];
+						consts[0] = max(0.0, expected[s] - table.budget);
+						consts[nconsts - 1] = max(0.0, pExceed[s] - riskTolerance);
+					}
+
+					/* a repaired option is written back as the middle of its interval */
+					if (repairMode == 2) {
+						double* repaired = &batchVars[(size_t)s * nvars];
+						for (int progIdx = 0; progIdx < nvars; progIdx++)
+							if (batchOpts[(size_t)s * nvars + progIdx] != decodedOpts[(size_t)s * nvars + progIdx])
+								repaired[progIdx] = batchOpts[(size_t)s * nvars + progIdx] + 0.5;
+						MOEA_Write_variables(nvars, repaired);
+					}
+
+					MOEA_Write_buffered(objs, consts);
+					if (capture != NULL)
+						trace_record(trace, TRACE_SCENARIO_BASE, &batchOpts[(size_t)s * nvars], objs, consts);
+				}
+				STATS_LAP(PHASE_FORMAT);
+				MOEA_Flush();
+				STATS_LAP(PHASE_FLUSH);
+				STATS_COUNT(COUNT_SOLUTIONS, nBatch);
+				STATS_COUNT(COUNT_BATCHES, 1);
+				STATS_POLL();
+				nBatch = 0;
+			}
+		}
 	}
 
+	if (capture != NULL)
+		close_trace(trace);
+	stats_finish();
 	MOEA_Terminate();
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,439 @@
+/* model.cpp
+ Loading of portfolio model definitions.
+
+ Text model format (blank lines and '#' comments ignored):
+
+   programs 22        number of programs
+   options 4          funding options per program, either one count for every
+                      program or a list of per-program counts
+   columns 3          values per option row in the data section
+   bau 0              data column holding the business-as-usual objective
+   ss 1               data column holding the ss objective
+   cost 2             data column holding the cost
+   threshold 35000    cost threshold before budget scaling
+   data               followed by the option rows, program by program
+
+ Time-phased budgets add per-year cost columns and thresholds:
+
+   years 5            number of fiscal years
+   year_costs 3 4 5 6 7
+                      data columns holding each year's cost
+   year_thresholds 8000 8000 7500 7000 7000
+                      per-year cost thresholds before budget scaling
+
+ If a time-phased model has no cost key, cost is the sum of the yearly costs.
+
+ The binary cache is written to <model file>.cache and reused as long as the
+ size and modification time of the text model are unchanged.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <algorithm>
+#include "model.h"
+
+#include "modeldfn.h"
+
+using namespace std;
+
+PortfolioModel::PortfolioModel() :
+		nPrograms(0), nRows(0), maxOptions(0), nYears(0), costThreshold(0), offsets(NULL), rows(NULL),
+		yearThresholds(NULL), yearRows(NULL), mapping(NULL), mappingSize(0) {
+}
+
+PortfolioModel::~PortfolioModel() {
+	release();
+}
+
+void PortfolioModel::release() {
+	if (mapping != NULL) {
+		munmap(mapping, mappingSize);
+		mapping = NULL;
+		mappingSize = 0;
+	}
+
+	offsetStorage.clear();
+	storage.clear();
+	yearThresholdStorage.clear();
+	yearStorage.clear();
+	offsets = NULL;
+	rows = NULL;
+	yearThresholds = NULL;
+	yearRows = NULL;
+	nPrograms = nRows = maxOptions = nYears = 0;
+}
+
+void PortfolioModel::attach_storage() {
+	offsets = &offsetStorage[0];
+	rows = &storage[0];
+	yearThresholds = yearThresholdStorage.empty() ? NULL : &yearThresholdStorage[0];
+	yearRows = yearStorage.empty() ? NULL : &yearStorage[0];
+	maxOptions = 0;
+	for (int progIdx = 0; progIdx < nPrograms; progIdx++)
+		maxOptions = max(maxOptions, options(progIdx));
+}
+
+void builtin_model(PortfolioModel& model) {
+	model.release();
+	model.nPrograms = 22;
+	model.nRows = 88;
+	model.costThreshold = 35000;
+	for (int progIdx = 0; progIdx <= model.nPrograms; progIdx++)
+		model.offsetStorage.push_back(4 * progIdx);
+	model.storage.assign(&modelmat[0][0], &modelmat[0][0] + 88 * nColumns);
+	model.attach_storage();
+}
+
+static void model_error(const char* fname, int line, const char* message) {
+	fprintf(stderr, "Error in model file %s, line %d: %s. Exiting...\n", fname, line, message);
+	exit(EXIT_FAILURE);
+}
+
+// Parses the values following the key on a header line.
+static vector<double> parse_list(const char* line) {
+	vector<double> values;
+	const char* p = line + strcspn(line, " \t");
+	char* end;
+
+	for (double value = strtod(p, &end); end != p; value = strtod(p, &end)) {
+		values.push_back(value);
+		p = end;
+	}
+
+	return values;
+}
+
+// Returns the next non-empty, non-comment line, or NULL at end of buffer.
+static char* next_line(char*& cursor, int& lineNo) {
+	while (*cursor != '\0') {
+		char* line = cursor;
+		char* end = line + strcspn(line, "\r\n");
+
+		cursor = end;
+		if (*cursor == '\r') cursor++;
+		if (*cursor == '\n') cursor++;
+		*end = '\0';
+		lineNo++;
+
+		char* hash = strchr(line, '#');
+		if (hash != NULL) *hash = '\0';
+
+		line += strspn(line, " \t");
+		if (*line != '\0') return line;
+	}
+
+	return NULL;
+}
+
+void parse_model(const char* fname, PortfolioModel& model) {
+	FILE* f = fopen(fname, "rb");
+
+	if (f == NULL) {
+		fprintf(stderr, "Error opening file %s. Exiting...\n", fname);
+		exit(EXIT_FAILURE);
+	}
+
+	string text;
+	char chunk[65536];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+		text.append(chunk, n);
+	fclose(f);
+
+	int programs = -1, columns = nColumns, years = 0;
+	vector<int> options;
+	vector<double> yearCols, yearThresholds;
+	bool haveThreshold = false, haveCost = false;
+	int colIdx[nColumns] = { COL_BAU, COL_SS, COL_COST };
+	double costThreshold = 0;
+	int lineNo = 0;
+	char* cursor = &text[0];
+	char* line;
+
+	/* header: one "key value" pair per line until "data" */
+	while ((line = next_line(cursor, lineNo)) != NULL) {
+		char key[32];
+		double value;
+		int fields = sscanf(line, "%31s %lf", key, &value);
+
+		if (strcmp(key, "data") == 0) break;
+		if (fields != 2) model_error(fname, lineNo, "expected a key and a value");
+
+		if (strcmp(key, "programs") == 0) programs = (int)value;
+		else if (strcmp(key, "options") == 0) {
+			vector<double> counts = parse_list(line);
+			options.assign(counts.begin(), counts.end());
+		}
+		else if (strcmp(key, "columns") == 0) columns = (int)value;
+		else if (strcmp(key, "bau") == 0) colIdx[COL_BAU] = (int)value;
+		else if (strcmp(key, "ss") == 0) colIdx[COL_SS] = (int)value;
+		else if (strcmp(key, "cost") == 0) {
+			colIdx[COL_COST] = (int)value;
+			haveCost = true;
+		}
+		else if (strcmp(key, "years") == 0) years = (int)value;
+		else if (strcmp(key, "year_costs") == 0) yearCols = parse_list(line);
+		else if (strcmp(key, "year_thresholds") == 0) yearThresholds = parse_list(line);
+		else if (strcmp(key, "threshold") == 0) {
+			costThreshold = value;
+			haveThreshold = true;
+		} else model_error(fname, lineNo, "unknown key");
+	}
+
+	if (line == NULL) model_error(fname, lineNo, "missing data section");
+	if (programs <= 0) model_error(fname, lineNo, "programs must be positive");
+	if (options.size() == 1) options.assign(programs, options[0]);
+	if ((int)options.size() != programs) model_error(fname, lineNo, "expected one option count or one per program");
+	if (*min_element(options.begin(), options.end()) <= 0 || *max_element(options.begin(), options.end()) > MAX_OPTIONS)
+		model_error(fname, lineNo, "option counts must be between 1 and 256");
+	if (!haveThreshold) model_error(fname, lineNo, "missing threshold");
+	if (years < 0 || years > MAX_YEARS) model_error(fname, lineNo, "years must be between 0 and 32");
+	if ((int)yearCols.size() != years || (int)yearThresholds.size() != years)
+		model_error(fname, lineNo, "expected one year_costs column and one year_thresholds value per year");
+	const bool yearCost = years > 0 && !haveCost; // cost is the total of the year columns
+	for (int c = 0; c < nColumns; c++)
+		if ((c != COL_COST || !yearCost) && (colIdx[c] < 0 || colIdx[c] >= columns))
+			model_error(fname, lineNo, "objective column out of range");
+	for (int y = 0; y < years; y++)
+		if (yearCols[y] < 0 || yearCols[y] >= columns) model_error(fname, lineNo, "year cost column out of range");
+
+	model.release();
+	model.nPrograms = programs;
+	model.costThreshold = costThreshold;
+	model.offsetStorage.resize(programs + 1);
+	model.offsetStorage[0] = 0;
+	for (int progIdx = 0; progIdx < programs; progIdx++)
+		model.offsetStorage[progIdx + 1] = model.offsetStorage[progIdx] + options[progIdx];
+	model.nRows = model.offsetStorage[programs];
+	model.storage.resize((size_t)model.nRows * nColumns);
+	model.nYears = years;
+	model.yearThresholdStorage = yearThresholds;
+	model.yearStorage.resize((size_t)model.nRows * years);
+
+	vector<double> values(columns);
+	for (int r = 0; r < model.nRows; r++) {
+		if ((line = next_line(cursor, lineNo)) == NULL) model_error(fname, lineNo, "too few data rows");
+
+		char* end;
+		for (int j = 0; j < columns; j++) {
+			values[j] = strtod(line, &end);
+			if (end == line) model_error(fname, lineNo, "expected a number");
+			line = end;
+		}
+
+		for (int c = 0; c < nColumns; c++)
+			if (c != COL_COST || !yearCost)
+				model.storage[(size_t)r * nColumns + c] = values[colIdx[c]];
+
+		double total = 0;
+		for (int y = 0; y < years; y++) {
+			model.yearStorage[(size_t)r * years + y] = values[(int)yearCols[y]];
+			total += values[(int)yearCols[y]];
+		}
+
+		if (yearCost)
+			model.storage[(size_t)r * nColumns + COL_COST] = total;
+	}
+
+	if (next_line(cursor, lineNo) != NULL) model_error(fname, lineNo, "unexpected data after last row");
+
+	model.attach_storage();
+}
+
+void save_model(const char* fname, const PortfolioModel& model) {
+	FILE* f = (strcmp(fname, "-") == 0) ? stdout : fopen(fname, "w");
+
+	if (f == NULL) {
+		fprintf(stderr, "Error opening file %s. Exiting...\n", fname);
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(f, "programs %d\noptions", model.nPrograms);
+	for (int progIdx = 0; progIdx < model.nPrograms; progIdx++)
+		fprintf(f, " %d", model.options(progIdx));
+	fprintf(f, "\ncolumns %d\nbau %d\nss %d\ncost %d\nthreshold %.17g\n",
+			nColumns + model.nYears, COL_BAU, COL_SS, COL_COST, model.costThreshold);
+
+	if (model.nYears > 0) {
+		fprintf(f, "years %d\nyear_costs", model.nYears);
+		for (int y = 0; y < model.nYears; y++)
+			fprintf(f, " %d", nColumns + y);
+		fprintf(f, "\nyear_thresholds");
+		for (int y = 0; y < model.nYears; y++)
+			fprintf(f, " %.17g", model.yearThresholds[y]);
+		fprintf(f, "\n");
+	}
+
+	fprintf(f, "data\n");
+	for (int r = 0; r < model.nRows; r++) {
+		const double* row = model.rows + r * nColumns;
+		fprintf(f, "%.17g %.17g %.17g", row[COL_BAU], row[COL_SS], row[COL_COST]);
+		for (int y = 0; y < model.nYears; y++)
+			fprintf(f, " %.17g", model.yearRows[(size_t)r * model.nYears + y]);
+		fprintf(f, "\n");
+	}
+
+	if (ferror(f) || (f != stdout && fclose(f) != 0)) {
+		fprintf(stderr, "Error writing file %s. Exiting...\n", fname);
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Start of a 64-byte aligned section following size bytes from pos.
+static uint64_t next_section(uint64_t pos, size_t size) {
+	return (pos + size + 63) / 64 * 64;
+}
+
+// Writes a section at its offset, padding from the current position.
+static bool write_section(FILE* f, uint64_t& pos, uint64_t offset, const void* data, size_t size) {
+	static const char pad[64] = { 0 };
+	size_t padding = offset - pos;
+
+	pos = offset + size;
+	return fwrite(pad, 1, padding, f) == padding && (size == 0 || fwrite(data, size, 1, f) == 1);
+}
+
+bool save_model_cache(const char* fname, const PortfolioModel& model,
+		uint64_t sourceSize, int64_t sourceMtime, int64_t sourceMtimeNsec) {
+	size_t offsetsSize = (model.nPrograms + 1) * sizeof(uint32_t);
+	size_t dataSize = (size_t)model.nRows * nColumns * sizeof(double);
+	size_t yearThresholdsSize = model.nYears * sizeof(double);
+	size_t yearDataSize = (size_t)model.nRows * model.nYears * sizeof(double);
+
+	ModelCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MODEL_CACHE_MAGIC, sizeof(MODEL_CACHE_MAGIC));
+	header.version = MODEL_CACHE_VERSION;
+	header.columns = nColumns;
+	header.nPrograms = model.nPrograms;
+	header.nRows = model.nRows;
+	header.nYears = model.nYears;
+	header.costThreshold = model.costThreshold;
+	header.sourceSize = sourceSize;
+	header.sourceMtime = sourceMtime;
+	header.sourceMtimeNsec = sourceMtimeNsec;
+	header.offsetsOffset = next_section(0, sizeof(header));
+	header.dataOffset = next_section(header.offsetsOffset, offsetsSize);
+	header.yearThresholdsOffset = next_section(header.dataOffset, dataSize);
+	header.yearDataOffset = next_section(header.yearThresholdsOffset, yearThresholdsSize);
+
+	/* write to a temporary and rename so readers never map a partial cache */
+	string cacheName = string(fname) + MODEL_CACHE_SUFFIX;
+	char tmpName[4096];
+	snprintf(tmpName, sizeof(tmpName), "%s.%d", cacheName.c_str(), (int)getpid());
+
+	FILE* f = fopen(tmpName, "wb");
+	if (f == NULL) return false;
+
+	uint64_t pos = 0;
+	bool ok = write_section(f, pos, 0, &header, sizeof(header))
+			&& write_section(f, pos, header.offsetsOffset, model.offsets, offsetsSize)
+			&& write_section(f, pos, header.dataOffset, model.rows, dataSize)
+			&& write_section(f, pos, header.yearThresholdsOffset, model.yearThresholds, yearThresholdsSize)
+			&& write_section(f, pos, header.yearDataOffset, model.yearRows, yearDataSize);
+	ok = (fclose(f) == 0) && ok;
+
+	if (!ok || rename(tmpName, cacheName.c_str()) != 0) {
+		unlink(tmpName);
+		return false;
+	}
+
+	return true;
+}
+
+// Maps the cache for fname if it exists, matches this build and is up to date.
+static bool map_model_cache(const char* fname, const struct stat& source, PortfolioModel& model) {
+	string cacheName = string(fname) + MODEL_CACHE_SUFFIX;
+	int fd = open(cacheName.c_str(), O_RDONLY);
+	if (fd == -1) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ModelCacheHeader)) {
+		close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return false;
+
+	const ModelCacheHeader* header = (const ModelCacheHeader*)mapping;
+	const char* base = (const char*)mapping;
+	size_t offsetsSize = ((size_t)header->nPrograms + 1) * sizeof(uint32_t);
+	size_t dataSize = (size_t)header->nRows * nColumns * sizeof(double);
+	size_t yearThresholdsSize = (size_t)header->nYears * sizeof(double);
+	size_t yearDataSize = (size_t)header->nRows * header->nYears * sizeof(double);
+
+	if (memcmp(header->magic, MODEL_CACHE_MAGIC, sizeof(MODEL_CACHE_MAGIC)) != 0
+			|| header->version != MODEL_CACHE_VERSION
+			|| header->columns != nColumns
+			|| header->nPrograms == 0
+			|| header->nYears > MAX_YEARS
+			|| header->sourceSize != (uint64_t)source.st_size
+			|| header->sourceMtime != (int64_t)source.st_mtim.tv_sec
+			|| header->sourceMtimeNsec != (int64_t)source.st_mtim.tv_nsec
+			|| header->offsetsOffset != next_section(0, sizeof(ModelCacheHeader))
+			|| header->dataOffset != next_section(header->offsetsOffset, offsetsSize)
+			|| header->yearThresholdsOffset != next_section(header->dataOffset, dataSize)
+			|| header->yearDataOffset != next_section(header->yearThresholdsOffset, yearThresholdsSize)
+			|| header->yearDataOffset + yearDataSize != (uint64_t)st.st_size) {
+		munmap(mapping, st.st_size);
+		return false;
+	}
+
+	/* the same limits parse_model enforces, so a corrupt cache cannot hand
+	 * out option indices that overflow a uint8_t or rows out of order */
+	const uint32_t* offsets = (const uint32_t*)(base + header->offsetsOffset);
+	bool valid = offsets[0] == 0 && offsets[header->nPrograms] == header->nRows;
+	for (uint32_t progIdx = 0; valid && progIdx < header->nPrograms; progIdx++)
+		valid = offsets[progIdx + 1] > offsets[progIdx] && offsets[progIdx + 1] - offsets[progIdx] <= MAX_OPTIONS;
+
+	if (!valid) {
+		munmap(mapping, st.st_size);
+		return false;
+	}
+
+	model.release();
+	model.nPrograms = header->nPrograms;
+	model.nRows = header->nRows;
+	model.nYears = header->nYears;
+	model.costThreshold = header->costThreshold;
+	model.offsets = offsets;
+	model.rows = (const double*)(base + header->dataOffset);
+	if (model.nYears > 0) {
+		model.yearThresholds = (const double*)(base + header->yearThresholdsOffset);
+		model.yearRows = (const double*)(base + header->yearDataOffset);
+	}
+	model.mapping = mapping;
+	model.mappingSize = st.st_size;
+	for (int progIdx = 0; progIdx < model.nPrograms; progIdx++)
+		model.maxOptions = max(model.maxOptions, model.options(progIdx));
+	return true;
+}
+
+void load_model(const char* fname, PortfolioModel& model) {
+	struct stat source;
+
+	if (stat(fname, &source) != 0) {
+		fprintf(stderr, "Error opening file %s. Exiting...\n", fname);
+		exit(EXIT_FAILURE);
+	}
+
+	if (map_model_cache(fname, source, model)) return;
+
+	parse_model(fname, model);
+
+	if (!save_model_cache(fname, model, source.st_size, source.st_mtim.tv_sec, source.st_mtim.tv_nsec)) {
+		fprintf(stderr, "Warning: unable to write model cache for %s\n", fname);
+		return;
+	}
+
+	/* switch over to the freshly written cache so every run shares its pages */
+	map_model_cache(fname, source, model);
+}
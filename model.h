@@ -0,0 +1,121 @@
+/*
+ * model.h
+ *
+ *  Portfolio model definition: the per-program option table (bau, ss, cost)
+ *  and the cost threshold.  Programs may have different numbers of funding
+ *  options, so the table is kept in compressed row form: offsets[progIdx] is
+ *  the first row of the program and offsets[nPrograms] the total row count.
+ *  A model is either the compiled-in table from modeldfn.h or a text file
+ *  loaded at startup.  Text models are converted on first load to a
+ *  versioned binary cache next to the source file, so later runs mmap the
+ *  table instead of parsing it.
+ */
+
+#ifndef MODEL_H_
+#define MODEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define nColumns 3 // bau, ss, cost
+#define COL_BAU 0
+#define COL_SS 1
+#define COL_COST 2
+#define MAX_OPTIONS 256 // option indices must fit in a byte
+#define MAX_YEARS 32     // fiscal years in a time-phased model
+
+#define MODEL_CACHE_MAGIC "PFMODEL"
+#define MODEL_CACHE_VERSION 3
+#define MODEL_CACHE_SUFFIX ".cache"
+
+/* On-disk layout of the binary cache.  The nPrograms+1 row offsets follow
+ * the header at offsetsOffset, and the nRows option rows of nColumns doubles
+ * start at dataOffset.  Time-phased models add nYears thresholds at
+ * yearThresholdsOffset and nRows rows of nYears costs at yearDataOffset. */
+struct ModelCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t columns;
+	uint32_t nPrograms;
+	uint32_t nRows;
+	uint32_t nYears;
+	uint32_t reserved;
+	double costThreshold;
+	uint64_t sourceSize;  // size and mtime of the text model the cache was
+	int64_t sourceMtime;  // built from, used to detect stale caches
+	int64_t sourceMtimeNsec;
+	uint64_t offsetsOffset;
+	uint64_t dataOffset;
+	uint64_t yearThresholdsOffset;
+	uint64_t yearDataOffset;
+};
+
+struct PortfolioModel {
+	int nPrograms;
+	int nRows;
+	int maxOptions;
+	int nYears;                   // 0 unless the budget is time-phased
+	double costThreshold;
+	const uint32_t* offsets;
+	const double* rows;
+	const double* yearThresholds; // per-year cost thresholds before budget scaling
+	const double* yearRows;       // per-year costs of each option row
+
+	PortfolioModel();
+	~PortfolioModel();
+
+	int options(int progIdx) const {
+		return offsets[progIdx + 1] - offsets[progIdx];
+	}
+
+	const double* row(int progIdx, int optIdx) const {
+		return rows + (offsets[progIdx] + optIdx) * nColumns;
+	}
+
+	const double* yearRow(int progIdx, int optIdx) const {
+		return yearRows + (offsets[progIdx] + optIdx) * nYears;
+	}
+
+	void release();
+
+	// Points offsets/rows at the storage vectors and derives maxOptions.
+	void attach_storage();
+
+	std::vector<uint32_t> offsetStorage; // backing store when the model is not mapped
+	std::vector<double> storage;
+	std::vector<double> yearThresholdStorage;
+	std::vector<double> yearStorage;
+	void* mapping;
+	size_t mappingSize;
+
+private:
+	PortfolioModel(const PortfolioModel&);
+	PortfolioModel& operator=(const PortfolioModel&);
+};
+
+// Maps a real-valued decision variable in [0, nOptions) to an option index,
+// clamping values outside the bounds to the nearest option.
+inline int option_index(double var, int nOptions) {
+	int optIdx = (int)var;
+	return optIdx < 0 ? 0 : (optIdx >= nOptions ? nOptions - 1 : optIdx);
+}
+
+// Fills the model from the compiled-in table in modeldfn.h.
+void builtin_model(PortfolioModel& model);
+
+// Loads a text model, preferring an up-to-date binary cache.  If the cache is
+// missing or stale, the text is parsed and a new cache written alongside it.
+void load_model(const char* fname, PortfolioModel& model);
+
+// Parses a text model without consulting or writing the cache.
+void parse_model(const char* fname, PortfolioModel& model);
+
+// Writes the model in text form; "-" writes to stdout.
+void save_model(const char* fname, const PortfolioModel& model);
+
+// Writes the binary cache for a model; returns false if it could not be saved.
+bool save_model_cache(const char* fname, const PortfolioModel& model,
+		uint64_t sourceSize, int64_t sourceMtime, int64_t sourceMtimeNsec);
+
+#endif /* MODEL_H_ */
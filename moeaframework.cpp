@@ -29,6 +29,9 @@
 #  include <sys/types.h>
 #  include <sys/socket.h>
 #  include <netdb.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <poll.h>
 #endif
 
 #define MOEA_WHITESPACE " \t"
@@ -44,6 +47,18 @@ int MOEA_Number_constraints;
 char* MOEA_Line_buffer = NULL;
 size_t MOEA_Line_position = 0;
 size_t MOEA_Line_limit = 0;
+unsigned long MOEA_Bytes_read = 0;
+unsigned long MOEA_Bytes_written = 0;
+
+/* counts output bytes only when built with instrumentation (stats.h) */
+static int MOEA_Count_written(int bytes) {
+#ifdef PORTFOLIO_STATS
+  if (bytes > 0) {
+    MOEA_Bytes_written += bytes;
+  }
+#endif
+  return bytes;
+}
 
 void MOEA_Error_callback_default(const MOEA_Status status) {
   MOEA_Debug("%s\n", MOEA_Status_message(status));
@@ -173,6 +188,12 @@ MOEA_Status MOEA_Init_socket(const int objectives, const int constraints,
   
   close(listenfd);
 
+  /* results are written a line at a time; without this, Nagle's algorithm
+   * holds each write until the delayed ACK of the previous one */
+  if (setsockopt(readfd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int)) == -1) {
+    MOEA_Debug("setsockopt: %s\n", strerror(errno));
+  }
+
   if ((writefd = dup(readfd)) == -1) {
     MOEA_Debug("dup: %s\n", strerror(errno));
     close(readfd);
@@ -260,6 +281,10 @@ MOEA_Status MOEA_Next_solution() {
   }
   
   MOEA_Line_position = 0;
+
+#ifdef PORTFOLIO_STATS
+  MOEA_Bytes_read += position;
+#endif
   
   if (position == 1) {
     return MOEA_EOF;
@@ -285,10 +310,15 @@ MOEA_Status MOEA_Read_token(char** token) {
   /* find end of token */
   size_t end = strcspn(MOEA_Line_buffer+MOEA_Line_position, MOEA_WHITESPACE);
   
-  /* create token */
-  MOEA_Line_buffer[MOEA_Line_position+end] = '\0';
+  /* create token, staying on the terminator if this is the last one */
   *token = MOEA_Line_buffer+MOEA_Line_position;
-  MOEA_Line_position += end + 1;
+
+  if (MOEA_Line_buffer[MOEA_Line_position+end] == '\0') {
+    MOEA_Line_position += end;
+  } else {
+    MOEA_Line_buffer[MOEA_Line_position+end] = '\0';
+    MOEA_Line_position += end + 1;
+  }
   
   return MOEA_SUCCESS;
 }
@@ -386,7 +416,68 @@ MOEA_Status MOEA_Read_doubles(const int size, double* values) {
   return MOEA_SUCCESS;
 }
 
+int MOEA_Read_keyword(const char* keyword) {
+  size_t start;
+  size_t length = strlen(keyword);
+
+  if (MOEA_Line_buffer == NULL) {
+    return 0;
+  }
+
+  start = MOEA_Line_position + strspn(MOEA_Line_buffer+MOEA_Line_position,
+      MOEA_WHITESPACE);
+
+  if ((strncmp(MOEA_Line_buffer+start, keyword, length) != 0) ||
+      ((MOEA_Line_buffer[start+length] != '\0') &&
+       (strchr(MOEA_WHITESPACE, MOEA_Line_buffer[start+length]) == NULL))) {
+    return 0;
+  }
+
+  MOEA_Line_position = start + length;
+  return 1;
+}
+
+int MOEA_End_of_line() {
+  if (MOEA_Line_buffer == NULL) {
+    return 1;
+  }
+
+  return MOEA_Line_buffer[MOEA_Line_position +
+      strspn(MOEA_Line_buffer+MOEA_Line_position, MOEA_WHITESPACE)] == '\0';
+}
+
+int MOEA_Input_pending() {
+#ifdef __GLIBC__
+  /* data already read into the stdio buffer */
+  if (MOEA_Stream_input->_IO_read_ptr < MOEA_Stream_input->_IO_read_end) {
+    return 1;
+  }
+#endif
+
+#ifdef MOEA_SOCKETS
+  struct pollfd pfd;
+  pfd.fd = fileno(MOEA_Stream_input);
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  return poll(&pfd, 1, 0) > 0;
+#else
+  return 0;
+#endif
+}
+
 MOEA_Status MOEA_Write(const double* objectives, const double* constraints) {
+  MOEA_Status status = MOEA_Write_buffered(objectives, constraints);
+
+  if (status != MOEA_SUCCESS) {
+    return status;
+  }
+
+  return MOEA_Flush();
+}
+
+MOEA_Status MOEA_Write_buffered(const double* objectives,
+    const double* constraints) {
   int i;
   
   /* validate inputs before writing results */
@@ -398,12 +489,12 @@ MOEA_Status MOEA_Write(const double* objectives, const double* constraints) {
   /* write objectives to output */
   for (i=0; i<MOEA_Number_objectives; i++) {
     if (i > 0) {
-      if (fprintf(MOEA_Stream_output, " ") < 0) {
+      if (MOEA_Count_written(fprintf(MOEA_Stream_output, " ")) < 0) {
         return MOEA_Error(MOEA_IO_ERROR);
       }
     }
     
-    if (fprintf(MOEA_Stream_output, "%.17g", objectives[i]) < 0) {
+    if (MOEA_Count_written(fprintf(MOEA_Stream_output, "%.17g", objectives[i])) < 0) {
       return MOEA_Error(MOEA_IO_ERROR);
     }
   }
@@ -411,25 +502,57 @@ MOEA_Status MOEA_Write(const double* objectives, const double* constraints) {
   /* write constraints to output */
   for (i=0; i<MOEA_Number_constraints; i++) {
     if ((MOEA_Number_objectives > 0) || (i > 0)) {
-      if (fprintf(MOEA_Stream_output, " ") < 0) {
+      if (MOEA_Count_written(fprintf(MOEA_Stream_output, " ")) < 0) {
         return MOEA_Error(MOEA_IO_ERROR);
       }
     }
   
-    if (fprintf(MOEA_Stream_output, "%.17g", constraints[i]) < 0) {
+    if (MOEA_Count_written(fprintf(MOEA_Stream_output, "%.17g", constraints[i])) < 0) {
       return MOEA_Error(MOEA_IO_ERROR);
     }
   }
   
-  /* end line and flush to push data out immediately */
-  if (fprintf(MOEA_Stream_output, "\n") < 0) {
+  /* end line */
+  if (MOEA_Count_written(fprintf(MOEA_Stream_output, "\n")) < 0) {
+    return MOEA_Error(MOEA_IO_ERROR);
+  }
+  
+  return MOEA_SUCCESS;
+}
+
+MOEA_Status MOEA_Write_variables(const int nvars, const double* variables) {
+  int i;
+
+  if ((variables == NULL) && (nvars > 0)) {
+    return MOEA_Error(MOEA_NULL_POINTER_ERROR);
+  }
+
+  for (i=0; i<nvars; i++) {
+    if (MOEA_Count_written(fprintf(MOEA_Stream_output, "%.17g ", variables[i])) < 0) {
+      return MOEA_Error(MOEA_IO_ERROR);
+    }
+  }
+
+  return MOEA_SUCCESS;
+}
+
+MOEA_Status MOEA_Write_error(const char* message) {
+  if (message == NULL) {
+    return MOEA_Error(MOEA_NULL_POINTER_ERROR);
+  }
+
+  if (MOEA_Count_written(fprintf(MOEA_Stream_output, "error %s\n", message)) < 0) {
     return MOEA_Error(MOEA_IO_ERROR);
   }
 
+  return MOEA_SUCCESS;
+}
+
+MOEA_Status MOEA_Flush() {
   if (fflush(MOEA_Stream_output) == EOF) {
     return MOEA_Error(MOEA_IO_ERROR);
   }
-  
+
   return MOEA_SUCCESS;
 }
 
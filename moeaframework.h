@@ -160,6 +160,82 @@ MOEA_Status MOEA_Read_permutation(const int, int*);
  */
 MOEA_Status MOEA_Write(const double*, const double*);
 
+/**
+ * Writes the objectives and constraints back to the MOEA Framework without
+ * flushing the output stream.  Use MOEA_Flush to push out a batch of results
+ * written this way.
+ *
+ * @param objectives the objective values
+ * @param constraints the constraint values
+ * @return MOEA_SUCCESS if this function call completed successfully; or the
+ *         specific error code causing failure
+ */
+MOEA_Status MOEA_Write_buffered(const double*, const double*);
+
+/**
+ * Writes decision variables ahead of the objectives of the next result, for
+ * drivers that adopt solutions modified by the evaluation (e.g. repaired
+ * ones).  The line then holds the variables, objectives and constraints.
+ *
+ * @param nvars the number of decision variables
+ * @param variables the decision variable values
+ * @return MOEA_SUCCESS if this function call completed successfully; or the
+ *         specific error code causing failure
+ */
+MOEA_Status MOEA_Write_variables(const int, const double*);
+
+/**
+ * Writes "error" and a message in place of the results of a rejected
+ * request, without flushing the output stream.
+ *
+ * @param message why the request was rejected
+ * @return MOEA_SUCCESS if this function call completed successfully; or the
+ *         specific error code causing failure
+ */
+MOEA_Status MOEA_Write_error(const char*);
+
+/**
+ * Bytes of solution lines read and of results written so far, counted only
+ * when built with PORTFOLIO_STATS (see stats.h).
+ */
+extern unsigned long MOEA_Bytes_read;
+extern unsigned long MOEA_Bytes_written;
+
+/**
+ * Flushes results written with MOEA_Write_buffered to the MOEA Framework.
+ *
+ * @return MOEA_SUCCESS if this function call completed successfully; or the
+ *         specific error code causing failure
+ */
+MOEA_Status MOEA_Flush();
+
+/**
+ * Consumes the next token of the current line if it equals the given
+ * keyword.  Lets a line carry a command in place of decision variables.
+ *
+ * @param keyword the expected token
+ * @return non-zero if the keyword was read; zero otherwise, in which case
+ *         nothing is consumed
+ */
+int MOEA_Read_keyword(const char*);
+
+/**
+ * Returns non-zero if nothing but whitespace is left on the current line.
+ *
+ * @return non-zero at the end of the line; zero otherwise
+ */
+int MOEA_End_of_line();
+
+/**
+ * Returns non-zero if more input can be read without blocking, either because
+ * it is already buffered or because the underlying descriptor is readable.
+ * A zero return means the MOEA Framework may be waiting on the results of the
+ * solutions read so far.
+ *
+ * @return non-zero if input is pending; zero otherwise
+ */
+int MOEA_Input_pending();
+
 /**
  * Writes a debug or other status message back to the MOEA Framework.  This
  * message will typically be displayed by the MOEA Framework, but the message
@@ -0,0 +1,177 @@
+/* montecarlo.cpp
+ Common-random-number Monte Carlo over lognormal cost growth.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include "montecarlo.h"
+#include "simd.h"
+
+using namespace std;
+
+void set_growth(MonteCarlo& mc, const double* z) {
+	const int half = mc.nSamples / 2;
+
+	for (int progIdx = 0; progIdx < mc.nPrograms; progIdx++) {
+		double* g = &mc.growth[(size_t)progIdx * mc.nSamples];
+		const double* zp = z + (size_t)progIdx * half;
+
+		for (int s = 0; s < half; s++) {
+			g[s] = exp(mc.mu + mc.sigma * zp[s]);
+			g[s + half] = exp(mc.mu - mc.sigma * zp[s]);
+		}
+	}
+}
+
+void init_monte_carlo(MonteCarlo& mc, int nPrograms, int nSamples, double sigma, double meanGrowth,
+		unsigned int seed) {
+	const int block = 2 * MC_SAMPLE_BLOCK;
+
+	mc.nPrograms = nPrograms;
+	mc.nSamples = max(block, (nSamples + block - 1) / block * block);
+	mc.sigma = sigma;
+	mc.mu = log(meanGrowth) - sigma * sigma / 2; // E[exp(mu + sigma*z)] = meanGrowth
+	mc.growth.resize((size_t)nPrograms * mc.nSamples);
+	mc.meanGrowth.assign(nPrograms, meanGrowth);
+
+	/* the same lognormal as boost/random/lognormal_distribution.hpp, drawn
+	 * through its underlying normal so the antithetic partner is exact */
+	boost::random::mt19937 rng(seed);
+	boost::random::normal_distribution<double> normal;
+	vector<double> z((size_t)nPrograms * (mc.nSamples / 2));
+
+	for (size_t i = 0; i < z.size(); i++)
+		z[i] = normal(rng);
+
+	set_growth(mc, &z[0]);
+}
+
+struct MonteCarloJob {
+	MonteCarlo* mc;
+	const ScenarioTable* table;
+	int nSolutions;
+	double* expected;
+	double* pExceed;
+};
+
+// Sampled totals for one block of MC_SOLUTION_BLOCK portfolios:
+// totals[k][s] = sum over programs of costs[k][p] * growth[p][s], with the
+// MC_SAMPLE_BLOCK samples of each portfolio held in vectors V.
+template <typename V>
+SIMD_KERNEL void totals_kernel(const MonteCarlo& mc, const double* costs, double* totals) {
+	const int W = sizeof(V) / sizeof(double);
+	const int nVectors = MC_SAMPLE_BLOCK / W;
+	const int nPrograms = mc.nPrograms;
+	const int nSamples = mc.nSamples;
+	const double* growth = &mc.growth[0];
+
+	for (int s0 = 0; s0 < nSamples; s0 += MC_SAMPLE_BLOCK) {
+		V acc[MC_SOLUTION_BLOCK][nVectors];
+
+		for (int k = 0; k < MC_SOLUTION_BLOCK; k++)
+			for (int v = 0; v < nVectors; v++)
+				acc[k][v] = V {};
+
+		for (int progIdx = 0; progIdx < nPrograms; progIdx++) {
+			const double* g = growth + (size_t)progIdx * nSamples + s0;
+			V gv[nVectors];
+			for (int v = 0; v < nVectors; v++)
+				gv[v] = loadv<V>(g + v * W);
+
+			for (int k = 0; k < MC_SOLUTION_BLOCK; k++) {
+				double c = costs[k * nPrograms + progIdx];
+				for (int v = 0; v < nVectors; v++)
+					acc[k][v] += c * gv[v];
+			}
+		}
+
+		for (int k = 0; k < MC_SOLUTION_BLOCK; k++)
+			for (int v = 0; v < nVectors; v++)
+				storev(totals + k * nSamples + s0 + v * W, acc[k][v]);
+	}
+}
+
+static void totals_sse2(const MonteCarlo& mc, const double* costs, double* totals) {
+	totals_kernel<v4df>(mc, costs, totals);
+}
+
+SIMD_TARGET_AVX2 static void totals_avx2(const MonteCarlo& mc, const double* costs, double* totals) {
+	totals_kernel<v4df>(mc, costs, totals);
+}
+
+SIMD_TARGET_AVX512 static void totals_avx512(const MonteCarlo& mc, const double* costs, double* totals) {
+	totals_kernel<v8df>(mc, costs, totals);
+}
+
+// Antithetic, control-variate estimate of P(total > budget).
+static double exceedance(const double* totals, int nSamples, double budget, double expectedTotal) {
+	const int half = nSamples / 2;
+	double sumI = 0, sumY = 0, sumIY = 0, sumYY = 0;
+
+	for (int s = 0; s < half; s++) {
+		double y = 0.5 * (totals[s] + totals[s + half]);
+		double i = 0.5 * ((totals[s] > budget) + (totals[s + half] > budget));
+
+		sumI += i;
+		sumY += y;
+		sumIY += i * y;
+		sumYY += y * y;
+	}
+
+	double meanI = sumI / half;
+	double meanY = sumY / half;
+	double covIY = sumIY / half - meanI * meanY;
+	double varY = sumYY / half - meanY * meanY;
+	double beta = (varY > 0) ? covIY / varY : 0.0;
+
+	return min(1.0, max(0.0, meanI - beta * (meanY - expectedTotal)));
+}
+
+static void monte_carlo_task(int task, int worker, void* context) {
+	MonteCarloJob* job = (MonteCarloJob*)context;
+	MonteCarlo& mc = *job->mc;
+	const int first = task * MC_SOLUTION_BLOCK;
+	const int count = min(MC_SOLUTION_BLOCK, job->nSolutions - first);
+	const double* costs = &mc.costs[(size_t)first * mc.nPrograms];
+	double* totals = &mc.totals[(size_t)first * mc.nSamples];
+
+	SIMD_DISPATCH(totals, (mc, costs, totals));
+
+	for (int k = 0; k < count; k++) {
+		double expectedTotal = 0;
+
+		for (int progIdx = 0; progIdx < mc.nPrograms; progIdx++)
+			expectedTotal += costs[k * mc.nPrograms + progIdx] * mc.meanGrowth[progIdx];
+
+		job->expected[first + k] = expectedTotal;
+		job->pExceed[first + k] = exceedance(totals + k * mc.nSamples, mc.nSamples, job->table->budget, expectedTotal);
+	}
+}
+
+void monte_carlo_costs(MonteCarlo& mc, const ScenarioTable& table, const uint8_t* opts, int nSolutions,
+		double* expected, double* pExceed, ThreadPool* pool) {
+	const int nBlocks = (nSolutions + MC_SOLUTION_BLOCK - 1) / MC_SOLUTION_BLOCK;
+	const size_t padded = (size_t)nBlocks * MC_SOLUTION_BLOCK;
+
+	if (mc.costs.size() < padded * mc.nPrograms) {
+		mc.costs.resize(padded * mc.nPrograms);
+		mc.totals.resize(padded * mc.nSamples);
+	}
+
+	/* gather the uncertainty-weighted cost of every program; padding rows stay zero */
+	fill(mc.costs.begin() + (size_t)nSolutions * mc.nPrograms, mc.costs.begin() + padded * mc.nPrograms, 0.0);
+	for (int i = 0; i < nSolutions; i++)
+		for (int progIdx = 0; progIdx < mc.nPrograms; progIdx++)
+			mc.costs[(size_t)i * mc.nPrograms + progIdx] = table.row(progIdx, opts[(size_t)i * mc.nPrograms + progIdx])[COL_COST];
+
+	MonteCarloJob job = { &mc, &table, nSolutions, expected, pExceed };
+
+	if (pool != NULL) {
+		pool->run(nBlocks, monte_carlo_task, &job);
+	} else {
+		for (int block = 0; block < nBlocks; block++)
+			monte_carlo_task(block, 0, &job);
+	}
+}
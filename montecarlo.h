@@ -0,0 +1,55 @@
+/*
+ * montecarlo.h
+ *
+ *  Monte Carlo evaluation of stochastic program costs.  Each program's cost
+ *  is multiplied by a lognormal growth factor, and for every portfolio the
+ *  expected cost and the probability that cost exceeds the scenario budget
+ *  are estimated.
+ *
+ *  The growth samples are drawn once and shared by every evaluation (common
+ *  random numbers), so differences between portfolios are not masked by
+ *  sampling noise.  Samples come in antithetic pairs, exp(mu + sigma*z) and
+ *  exp(mu - sigma*z), and the exceedance probability uses the sampled total
+ *  cost as a control variate, its exact mean being known.  A whole batch of
+ *  portfolios is swept at once as a blocked product of the portfolio cost
+ *  matrix with the growth matrix.
+ */
+
+#ifndef MONTECARLO_H_
+#define MONTECARLO_H_
+
+#include <vector>
+#include "portfolio.h"
+#include "threadpool.h"
+
+#define MC_SOLUTION_BLOCK 4 // portfolios sharing each load of growth samples
+#define MC_SAMPLE_BLOCK 8   // samples accumulated in registers per portfolio
+
+struct MonteCarlo {
+	int nPrograms;
+	int nSamples;                   // a multiple of 2*MC_SAMPLE_BLOCK
+	double mu;
+	double sigma;
+	std::vector<double> growth;     // nSamples growth factors per program
+	std::vector<double> meanGrowth; // exact expected growth of each program
+
+	std::vector<double> costs;      // workspace: cost of each program per portfolio
+	std::vector<double> totals;     // workspace: sampled total cost per portfolio
+};
+
+// Draws nSamples (rounded up) lognormal growth factors with mean meanGrowth
+// and log-scale standard deviation sigma for every program.
+void init_monte_carlo(MonteCarlo& mc, int nPrograms, int nSamples, double sigma, double meanGrowth,
+		unsigned int seed);
+
+// Replaces the growth samples with exp(mu + sigma*z) for the standard normal
+// draws z, nSamples/2 per program stored program by program; the second
+// half of each program's samples is the antithetic counterpart.
+void set_growth(MonteCarlo& mc, const double* z);
+
+// Estimates, for each of nSolutions portfolios given as option indices, the
+// expected cost and the probability that cost exceeds table.budget.
+void monte_carlo_costs(MonteCarlo& mc, const ScenarioTable& table, const uint8_t* opts, int nSolutions,
+		double* expected, double* pExceed, ThreadPool* pool);
+
+#endif /* MONTECARLO_H_ */
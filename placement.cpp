@@ -0,0 +1,166 @@
+/* placement.cpp
+ Huge-page buffers, NUMA interleaving and worker pinning.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <algorithm>
+#include "placement.h"
+#include "threadpool.h"
+
+using namespace std;
+
+// Parses a kernel list such as "0-3,8,10-11".
+static vector<int> parse_list(const char* text) {
+	vector<int> values;
+	const char* p = text;
+
+	while (*p >= '0' && *p <= '9') {
+		char* end;
+		int first = strtol(p, &end, 10), last = first;
+		if (*end == '-')
+			last = strtol(end + 1, &end, 10);
+
+		for (int v = first; v <= last; v++)
+			values.push_back(v);
+
+		p = (*end == ',') ? end + 1 : end;
+	}
+
+	return values;
+}
+
+static bool read_list(const char* filename, vector<int>& values) {
+	FILE* file = fopen(filename, "r");
+	char line[4096];
+
+	if (file == NULL) return false;
+
+	bool ok = fgets(line, sizeof(line), file) != NULL;
+	fclose(file);
+	if (ok) values = parse_list(line);
+	return ok;
+}
+
+static vector<NumaNode> read_nodes() {
+	vector<NumaNode> nodes;
+	vector<int> online;
+	cpu_set_t allowed;
+
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		for (int cpu = 0; cpu < hardware_threads() && cpu < CPU_SETSIZE; cpu++)
+			CPU_SET(cpu, &allowed);
+	}
+
+	if (read_list("/sys/devices/system/node/online", online)) {
+		for (size_t i = 0; i < online.size(); i++) {
+			char filename[64];
+			vector<int> cpus;
+			NumaNode node;
+
+			snprintf(filename, sizeof(filename), "/sys/devices/system/node/node%d/cpulist", online[i]);
+			if (!read_list(filename, cpus)) continue;
+
+			node.id = online[i];
+			for (size_t c = 0; c < cpus.size(); c++)
+				if (cpus[c] < CPU_SETSIZE && CPU_ISSET(cpus[c], &allowed))
+					node.cpus.push_back(cpus[c]);
+
+			/* memory-only nodes have no CPUs to pin to */
+			if (!node.cpus.empty())
+				nodes.push_back(node);
+		}
+	}
+
+	if (nodes.empty()) {
+		NumaNode node;
+		node.id = 0;
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &allowed))
+				node.cpus.push_back(cpu);
+		nodes.push_back(node);
+	}
+
+	return nodes;
+}
+
+const vector<NumaNode>& numa_nodes() {
+	static const vector<NumaNode> nodes = read_nodes();
+	return nodes;
+}
+
+void pin_worker(int worker) {
+	const vector<NumaNode>& nodes = numa_nodes();
+	const NumaNode& node = nodes[worker % nodes.size()];
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(node.cpus[(worker / nodes.size()) % node.cpus.size()], &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+// Spreads the pages of a mapping over the nodes.  A hint: failures are
+// ignored, leaving the default first-touch policy.
+static void interleave(void* buffer, size_t bytes) {
+	const vector<NumaNode>& nodes = numa_nodes();
+	unsigned long mask[16] = { 0 };
+	int maxNode = 0;
+
+	if (nodes.size() < 2) return;
+
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].id >= (int)(sizeof(mask) * 8)) return;
+		mask[nodes[i].id / 64] |= 1UL << (nodes[i].id % 64);
+		maxNode = max(maxNode, nodes[i].id);
+	}
+
+	syscall(SYS_mbind, buffer, bytes, MPOL_INTERLEAVE, mask, (unsigned long)maxNode + 2, 0);
+}
+
+void* alloc_buffer(size_t bytes, BufferPlacement placement) {
+	if (bytes < HUGE_PAGE_SIZE)
+		return ::operator new(bytes);
+
+	const size_t size = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+	void* buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+	/* no reserved huge pages: normal pages on a 2 MB boundary, so that
+	 * transparent huge pages can back them */
+	if (buffer == MAP_FAILED) {
+		char* mapped = (char*)mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+				-1, 0);
+		if (mapped == MAP_FAILED) {
+			fprintf(stderr, "Unable to allocate %zu bytes\n", bytes);
+			exit(EXIT_FAILURE);
+		}
+
+		char* aligned = (char*)(((uintptr_t)mapped + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+		if (aligned > mapped)
+			munmap(mapped, aligned - mapped);
+		munmap(aligned + size, mapped + HUGE_PAGE_SIZE - aligned);
+
+		madvise(aligned, size, MADV_HUGEPAGE);
+		buffer = aligned;
+	}
+
+	if (placement == PLACE_INTERLEAVE)
+		interleave(buffer, size);
+	return buffer;
+}
+
+void free_buffer(void* buffer, size_t bytes) {
+	if (bytes < HUGE_PAGE_SIZE) {
+		::operator delete(buffer);
+		return;
+	}
+
+	munmap(buffer, (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+}
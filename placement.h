@@ -0,0 +1,101 @@
+/*
+ * placement.h
+ *
+ *  Large buffers on 2 MB huge pages, placed across NUMA nodes, and pinning
+ *  of pool workers to match.  A buffer of at least a huge page first asks
+ *  for reserved huge pages (MAP_HUGETLB, see /proc/sys/vm/nr_hugepages) and
+ *  otherwise maps normal pages aligned to 2 MB and asks for transparent huge
+ *  pages with madvise.  Smaller buffers come from the heap.
+ *
+ *  Buffers read by every worker (the scenario matrix and its float copy)
+ *  are SharedBuffers, interleaved page by page over the nodes so no socket's
+ *  memory serves them all.  A worker's own workspace is a LocalBuffer: its
+ *  elements are left uninitialized, so each page lands on the node of the
+ *  thread that first writes it, and the workspace is allocated and written
+ *  by that worker.  This only pays off if workers stay put, which a pool
+ *  created with pinned set ensures (pin_worker).  On a single node the
+ *  placement steps are skipped.
+ */
+
+#ifndef PLACEMENT_H_
+#define PLACEMENT_H_
+
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <vector>
+
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+enum BufferPlacement { PLACE_FIRST_TOUCH, PLACE_INTERLEAVE };
+
+struct NumaNode {
+	int id;
+	std::vector<int> cpus;          // those this process may run on
+};
+
+// The nodes with CPUs this process may run on, read once from
+// /sys/devices/system/node.  Without it, one node holding every CPU.
+const std::vector<NumaNode>& numa_nodes();
+
+// Pins the calling thread, worker of a pool, to a CPU of node
+// worker % nodes, so consecutive workers alternate between the sockets.
+void pin_worker(int worker);
+
+// Maps a buffer as described above.  Exits if there is no memory.
+void* alloc_buffer(size_t bytes, BufferPlacement placement);
+
+void free_buffer(void* buffer, size_t bytes);
+
+// Allocator over alloc_buffer.  Elements are default-initialized, so a
+// buffer of plain values is not touched until it is first written.
+template <typename T, BufferPlacement Placement>
+struct BufferAllocator {
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind {
+		typedef BufferAllocator<U, Placement> other;
+	};
+
+	BufferAllocator() {
+	}
+
+	template <typename U>
+	BufferAllocator(const BufferAllocator<U, Placement>&) {
+	}
+
+	T* allocate(size_t n) {
+		return (T*)alloc_buffer(n * sizeof(T), Placement);
+	}
+
+	void deallocate(T* p, size_t n) {
+		free_buffer(p, n * sizeof(T));
+	}
+
+	template <typename U>
+	void construct(U* p) {
+		::new ((void*)p) U;
+	}
+
+	template <typename U, typename... Args>
+	void construct(U* p, Args&&... args) {
+		::new ((void*)p) U(std::forward<Args>(args)...);
+	}
+
+	bool operator==(const BufferAllocator&) const {
+		return true;
+	}
+
+	bool operator!=(const BufferAllocator&) const {
+		return false;
+	}
+};
+
+template <typename T>
+using SharedBuffer = std::vector<T, BufferAllocator<T, PLACE_INTERLEAVE> >;
+
+template <typename T>
+using LocalBuffer = std::vector<T, BufferAllocator<T, PLACE_FIRST_TOUCH> >;
+
+#endif /* PLACEMENT_H_ */
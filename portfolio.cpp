@@ -0,0 +1,152 @@
+/* portfolio.cpp
+ Evaluation of the 3 objective portfolio formulation.
+
+ Objectives (minimized): business-as-usual (bau), ss and cost, each the sum
+ over programs of the selected option's value weighted by the program's
+ uncertainty multiplier and then multiplied by the scenario scale.
+ Constraint: cost may not exceed the cost threshold times the budget scale.
+ Time-phased models add one constraint per year: the year's cost may not
+ exceed that year's threshold times the budget scale.
+ */
+
+#include <algorithm>
+#include "portfolio.h"
+
+using namespace std;
+
+void default_scenario(const PortfolioModel& model, Scenario& scenario) {
+	scenario.uncertainty.assign(model.nPrograms, 1.0);
+	scenario.bauScale = 1.0;
+	scenario.ssScale = 1.0;
+	scenario.costScale = 1.0;
+	scenario.budgetScale = 1.0;
+}
+
+void build_scenario_table(const PortfolioModel& model, const Scenario& scenario, ScenarioTable& table) {
+	table.nPrograms = model.nPrograms;
+	table.offsets.assign(model.offsets, model.offsets + model.nPrograms + 1);
+	table.rows.assign((size_t)model.nRows * TABLE_STRIDE, 0.0);
+
+	for (int progIdx = 0; progIdx < model.nPrograms; progIdx++) {
+		for (int optIdx = 0; optIdx < model.options(progIdx); optIdx++) {
+			const double* src = model.row(progIdx, optIdx);
+			double* dst = &table.rows[(model.offsets[progIdx] + optIdx) * TABLE_STRIDE];
+
+			for (int c = 0; c < nColumns; c++)
+				dst[c] = scenario.uncertainty[progIdx] * src[c];
+		}
+	}
+
+	table.nYears = model.nYears;
+	table.yearStride = (model.nYears + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	table.yearRows.assign((size_t)model.nRows * table.yearStride, 0.0);
+	fill_n(table.yearBudget, MAX_YEARS, 0.0);
+
+	for (int progIdx = 0; progIdx < model.nPrograms && model.nYears > 0; progIdx++) {
+		for (int optIdx = 0; optIdx < model.options(progIdx); optIdx++) {
+			const double* src = model.yearRow(progIdx, optIdx);
+			double* dst = &table.yearRows[(model.offsets[progIdx] + optIdx) * table.yearStride];
+
+			for (int y = 0; y < model.nYears; y++)
+				dst[y] = scenario.uncertainty[progIdx] * src[y];
+		}
+	}
+
+	for (int y = 0; y < model.nYears; y++)
+		table.yearBudget[y] = model.yearThresholds[y] * scenario.budgetScale;
+
+	table.scale[COL_BAU] = scenario.bauScale;
+	table.scale[COL_SS] = scenario.ssScale;
+	table.scale[COL_COST] = scenario.costScale;
+	table.budget = model.costThreshold * scenario.budgetScale;
+
+	/* rounding is monotonic, so no portfolio's sum, summed in program order
+	 * like this one, is worse */
+	for (int c = 0; c < nColumns; c++) {
+		double sum = 0;
+
+		for (int progIdx = 0; progIdx < model.nPrograms; progIdx++) {
+			double worst = table.row(progIdx, 0)[c];
+			for (int optIdx = 1; optIdx < model.options(progIdx); optIdx++)
+				worst = table.scale[c] < 0 ? min(worst, table.row(progIdx, optIdx)[c])
+						: max(worst, table.row(progIdx, optIdx)[c]);
+			sum += worst;
+		}
+
+		table.nadir[c] = sum * table.scale[c];
+	}
+}
+
+void portfolio_problem(const PortfolioModel& model, const Scenario& scenario,
+		const double* vars, double* objs, double* consts) {
+	double bau = 0, ss = 0, cost = 0;
+	int optIdx; // Option Index
+
+	for (int progIdx = 0; progIdx < model.nPrograms; progIdx++) {
+		optIdx = option_index(vars[progIdx], model.options(progIdx));
+
+		bau += scenario.uncertainty[progIdx] * model.row(progIdx, optIdx)[COL_BAU];
+		ss += scenario.uncertainty[progIdx] * model.row(progIdx, optIdx)[COL_SS];
+		cost += scenario.uncertainty[progIdx] * model.row(progIdx, optIdx)[COL_COST];
+	}
+
+	// Calculate minimization objectives (defined in comments at beginning of file)
+	objs[0] = bau * scenario.bauScale;
+	objs[1] = ss * scenario.ssScale;
+	objs[2] = cost * scenario.costScale;
+
+	consts[0] = max(0.0, cost - model.costThreshold * scenario.budgetScale);
+
+	for (int y = 0; y < model.nYears; y++) {
+		double yearCost = 0;
+
+		for (int progIdx = 0; progIdx < model.nPrograms; progIdx++) {
+			optIdx = option_index(vars[progIdx], model.options(progIdx));
+			yearCost += scenario.uncertainty[progIdx] * model.yearRow(progIdx, optIdx)[y];
+		}
+
+		consts[1 + y] = max(0.0, yearCost - model.yearThresholds[y] * scenario.budgetScale);
+	}
+}
+
+void evaluate_table(const ScenarioTable& table, const double* vars, double* objs, double* consts) {
+	double bau = 0, ss = 0, cost = 0;
+
+	for (int progIdx = 0; progIdx < table.nPrograms; progIdx++) {
+		const double* row = table.row(progIdx, option_index(vars[progIdx], table.options(progIdx)));
+
+		bau += row[COL_BAU];
+		ss += row[COL_SS];
+		cost += row[COL_COST];
+	}
+
+	objs[0] = bau * table.scale[COL_BAU];
+	objs[1] = ss * table.scale[COL_SS];
+	objs[2] = cost * table.scale[COL_COST];
+
+	consts[0] = max(0.0, cost - table.budget);
+
+	if (table.nYears > 0)
+		year_constraints(table, [&](int progIdx) { return option_index(vars[progIdx], table.options(progIdx)); }, consts + 1);
+}
+
+void evaluate_options(const ScenarioTable& table, const int* opts, double* objs, double* consts) {
+	double bau = 0, ss = 0, cost = 0;
+
+	for (int progIdx = 0; progIdx < table.nPrograms; progIdx++) {
+		const double* row = table.row(progIdx, opts[progIdx]);
+
+		bau += row[COL_BAU];
+		ss += row[COL_SS];
+		cost += row[COL_COST];
+	}
+
+	objs[0] = bau * table.scale[COL_BAU];
+	objs[1] = ss * table.scale[COL_SS];
+	objs[2] = cost * table.scale[COL_COST];
+
+	consts[0] = max(0.0, cost - table.budget);
+
+	if (table.nYears > 0)
+		year_constraints(table, [&](int progIdx) { return opts[progIdx]; }, consts + 1);
+}
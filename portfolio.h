@@ -0,0 +1,103 @@
+/*
+ * portfolio.h
+ *
+ *  Scenario definition and evaluation of the portfolio formulation.  A
+ *  scenario is the set of per-program uncertainty multipliers plus the four
+ *  objective/budget scales; evaluation against a scenario goes through a
+ *  precomputed table holding the uncertainty-weighted option rows.
+ */
+
+#ifndef PORTFOLIO_H_
+#define PORTFOLIO_H_
+
+#include <algorithm>
+#include <vector>
+#include "model.h"
+#include "simd.h"
+
+#define TABLE_STRIDE 4 // option rows padded to 32 bytes
+
+struct Scenario {
+	std::vector<double> uncertainty;
+	double bauScale;
+	double ssScale;
+	double costScale;
+	double budgetScale;
+};
+
+struct ScenarioTable {
+	int nPrograms;
+	std::vector<uint32_t> offsets; // same compressed row offsets as the model
+	std::vector<double> rows;      // uncertainty[progIdx] * option row, TABLE_STRIDE apart
+	double scale[nColumns];
+	double budget;                 // costThreshold * budgetScale
+	double nadir[nColumns];        // worst value of each objective over all portfolios
+
+	int nYears;                    // time-phased budgets only, otherwise 0
+	int yearStride;                // nYears rounded up to SIMD_WIDTH
+	std::vector<double> yearRows;  // uncertainty-weighted yearly costs, yearStride apart
+	double yearBudget[MAX_YEARS];  // yearThresholds * budgetScale
+
+	int options(int progIdx) const {
+		return offsets[progIdx + 1] - offsets[progIdx];
+	}
+
+	const double* row(int progIdx, int optIdx) const {
+		return &rows[(offsets[progIdx] + optIdx) * TABLE_STRIDE];
+	}
+
+	const double* yearRow(int progIdx, int optIdx) const {
+		return &yearRows[(offsets[progIdx] + optIdx) * yearStride];
+	}
+
+	// Constraints per evaluation: the total budget, then one per year.
+	int constraints() const {
+		return 1 + nYears;
+	}
+};
+
+/* Accumulates the yearly cost of a portfolio, whose option for each program
+ * is given by option(progIdx), and writes one constraint per year.  Years
+ * are summed SIMD_WIDTH at a time in fixed-size registers, so the kernel
+ * never allocates. */
+template <class OptionOf>
+inline void year_constraints(const ScenarioTable& table, OptionOf option, double* consts) {
+	v4df acc[MAX_YEARS / SIMD_WIDTH];
+	double sums[MAX_YEARS];
+	const int nVec = table.yearStride / SIMD_WIDTH;
+
+	for (int v = 0; v < nVec; v++)
+		acc[v] = v4df { 0.0, 0.0, 0.0, 0.0 };
+
+	for (int progIdx = 0; progIdx < table.nPrograms; progIdx++) {
+		const double* row = table.yearRow(progIdx, option(progIdx));
+
+		for (int v = 0; v < nVec; v++)
+			acc[v] += load4(row + v * SIMD_WIDTH);
+	}
+
+	for (int v = 0; v < nVec; v++)
+		store4(sums + v * SIMD_WIDTH, acc[v]);
+
+	for (int y = 0; y < table.nYears; y++)
+		consts[y] = std::max(0.0, sums[y] - table.yearBudget[y]);
+}
+
+// Nominal scenario: every multiplier and scale set to 1.
+void default_scenario(const PortfolioModel& model, Scenario& scenario);
+
+void build_scenario_table(const PortfolioModel& model, const Scenario& scenario, ScenarioTable& table);
+
+// Reference evaluation straight from the model rows.
+void portfolio_problem(const PortfolioModel& model, const Scenario& scenario,
+		const double* vars, double* objs, double* consts);
+
+// Evaluation against a precomputed scenario table; results are identical to
+// portfolio_problem for the scenario the table was built from.  Every
+// evaluation writes nColumns objectives and table.constraints() constraints.
+void evaluate_table(const ScenarioTable& table, const double* vars, double* objs, double* consts);
+
+// As evaluate_table, for a portfolio given as option indices.
+void evaluate_options(const ScenarioTable& table, const int* opts, double* objs, double* consts);
+
+#endif /* PORTFOLIO_H_ */
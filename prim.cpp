@@ -0,0 +1,173 @@
+/* prim.cpp
+ Box peeling over column-sorted scenarios.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "prim.h"
+
+using namespace std;
+
+struct PrimPeel {
+	bool valid;
+	int removed;      // points leaving the box
+	int removedCases;
+	double bound;     // new lower or upper bound
+};
+
+struct PrimState {
+	const double* x;
+	int nPoints;
+	int nDims;
+	const boost::dynamic_bitset<>* cases;
+	boost::dynamic_bitset<> inside;
+	vector<vector<int> > order; // points sorted on each input
+	vector<int> lo;             // first position of order[d] still inside the bounds
+	vector<int> hi;             // one past the last
+	int nInside;
+	int target;                 // points to remove per peel
+	int minInside;
+	vector<PrimPeel> peels;     // candidates: lower then upper peel of each input
+};
+
+// Removes at least target inside points from one end of input d, plus any
+// tied with the last one removed.  step is +1 from below and -1 from above.
+static PrimPeel score_peel(const PrimState& state, int d, int step) {
+	const vector<int>& order = state.order[d];
+	const double* xd = state.x + (size_t)d * state.nPoints;
+	PrimPeel peel = { false, 0, 0, 0.0 };
+	int pos = (step > 0) ? state.lo[d] : state.hi[d] - 1;
+	int end = (step > 0) ? state.hi[d] : state.lo[d] - 1;
+	double last = NAN;
+
+	for (; pos != end; pos += step) {
+		int i = order[pos];
+		if (!state.inside[i]) continue;
+		if (peel.removed >= state.target && xd[i] != last) {
+			peel.bound = xd[i];
+			peel.valid = state.nInside - peel.removed >= state.minInside;
+			return peel;
+		}
+
+		peel.removed++;
+		peel.removedCases += (*state.cases)[i];
+		last = xd[i];
+	}
+
+	return peel; // nothing would be left
+}
+
+static void score_task(int task, int worker, void* context) {
+	PrimState* state = (PrimState*)context;
+
+	state->peels[2 * task] = score_peel(*state, task, +1);
+	state->peels[2 * task + 1] = score_peel(*state, task, -1);
+}
+
+static void sort_task(int task, int worker, void* context) {
+	PrimState* state = (PrimState*)context;
+	const double* xd = state->x + (size_t)task * state->nPoints;
+	vector<int>& order = state->order[task];
+
+	order.resize(state->nPoints);
+	for (int i = 0; i < state->nPoints; i++)
+		order[i] = i;
+	sort(order.begin(), order.end(), [xd](int a, int b) { return xd[a] < xd[b]; });
+}
+
+static void record(const PrimState& state, const PrimBox& box, int nCases, int totalCases,
+		vector<PrimBox>& trajectory) {
+	trajectory.push_back(box);
+	PrimBox& last = trajectory.back();
+
+	last.nInside = state.nInside;
+	last.nCases = nCases;
+	last.coverage = (totalCases > 0) ? (double)nCases / totalCases : 0.0;
+	last.density = (state.nInside > 0) ? (double)nCases / state.nInside : 0.0;
+	last.support = (double)state.nInside / state.nPoints;
+}
+
+void prim_peel(const double* x, int nPoints, int nDims, const boost::dynamic_bitset<>& cases,
+		const PrimOptions& options, vector<PrimBox>& trajectory, ThreadPool* pool) {
+	PrimState state;
+	PrimBox box;
+
+	state.x = x;
+	state.nPoints = nPoints;
+	state.nDims = nDims;
+	state.cases = &cases;
+	state.inside.resize(nPoints, true);
+	state.order.resize(nDims);
+	state.lo.assign(nDims, 0);
+	state.hi.assign(nDims, nPoints);
+	state.nInside = nPoints;
+	state.minInside = max(1, (int)ceil(options.minSupport * nPoints));
+	state.peels.resize(2 * nDims);
+
+	if (pool != NULL) {
+		pool->run(nDims, sort_task, &state);
+	} else {
+		for (int d = 0; d < nDims; d++)
+			sort_task(d, 0, &state);
+	}
+
+	box.lower.resize(nDims);
+	box.upper.resize(nDims);
+	for (int d = 0; d < nDims && nPoints > 0; d++) {
+		box.lower[d] = x[(size_t)d * nPoints + state.order[d].front()];
+		box.upper[d] = x[(size_t)d * nPoints + state.order[d].back()];
+	}
+
+	const int totalCases = (int)cases.count();
+	int nCases = totalCases;
+
+	trajectory.clear();
+	record(state, box, nCases, totalCases, trajectory);
+
+	for (;;) {
+		state.target = max(1, (int)(options.alpha * state.nInside));
+
+		if (pool != NULL) {
+			pool->run(nDims, score_task, &state);
+		} else {
+			for (int d = 0; d < nDims; d++)
+				score_task(d, 0, &state);
+		}
+
+		/* the peel leaving the highest density, then the one removing fewest */
+		int best = -1;
+		double bestDensity = -1.0;
+		for (int c = 0; c < 2 * nDims; c++) {
+			const PrimPeel& peel = state.peels[c];
+			if (!peel.valid) continue;
+
+			double density = (double)(nCases - peel.removedCases) / (state.nInside - peel.removed);
+			if (density > bestDensity || (density == bestDensity && peel.removed < state.peels[best].removed)) {
+				best = c;
+				bestDensity = density;
+			}
+		}
+
+		if (best < 0) break;
+
+		/* drop the peeled points and move the bound */
+		const int d = best / 2;
+		const PrimPeel& peel = state.peels[best];
+		const double* xd = x + (size_t)d * nPoints;
+		const vector<int>& order = state.order[d];
+
+		if (best % 2 == 0) {
+			for (; xd[order[state.lo[d]]] < peel.bound; state.lo[d]++)
+				state.inside[order[state.lo[d]]] = false;
+			box.lower[d] = peel.bound;
+		} else {
+			for (; xd[order[state.hi[d] - 1]] > peel.bound; state.hi[d]--)
+				state.inside[order[state.hi[d] - 1]] = false;
+			box.upper[d] = peel.bound;
+		}
+
+		state.nInside -= peel.removed;
+		nCases -= peel.removedCases;
+		record(state, box, nCases, totalCases, trajectory);
+	}
+}
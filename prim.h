@@ -0,0 +1,43 @@
+/*
+ * prim.h
+ *
+ *  Scenario discovery with PRIM (the Patient Rule Induction Method).  Given a
+ *  set of scenarios and the scenarios of interest among them (e.g. those
+ *  where a portfolio breaks the budget), PRIM peels a box down from the full
+ *  range of the inputs, each step removing the sliver of points below or
+ *  above a quantile of one input that most raises the share of cases left in
+ *  the box, until the box would hold too few points.
+ *
+ *  Every input is sorted once; box membership and the cases are bitsets, and
+ *  the candidate peels of the different inputs are scored in parallel.
+ */
+
+#ifndef PRIM_H_
+#define PRIM_H_
+
+#include <vector>
+#include <boost/dynamic_bitset.hpp>
+#include "threadpool.h"
+
+struct PrimOptions {
+	double alpha;      // fraction of the box's points removed per peel
+	double minSupport; // smallest fraction of all points a box may hold
+};
+
+struct PrimBox {
+	std::vector<double> lower; // inclusive bounds on every input
+	std::vector<double> upper;
+	int nInside;
+	int nCases;
+	double coverage;           // share of all cases inside the box
+	double density;            // share of the box's points that are cases
+	double support;            // share of all points inside the box
+};
+
+// Peels boxes over nPoints points of nDims inputs, stored input by input
+// (input d of point i at d*nPoints + i).  trajectory receives the full box
+// first and then the box after every peel.
+void prim_peel(const double* x, int nPoints, int nDims, const boost::dynamic_bitset<>& cases,
+		const PrimOptions& options, std::vector<PrimBox>& trajectory, ThreadPool* pool);
+
+#endif /* PRIM_H_ */
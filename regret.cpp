@@ -0,0 +1,135 @@
+/* regret.cpp
+ Per-scenario ideal points and regret statistics.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "regret.h"
+
+using namespace std;
+
+void init_regret(RegretEnsemble& ensemble, const PortfolioModel& model, const vector<double>& inputs,
+		int nScenarios, double quantile, bool single) {
+	ensemble.nPrograms = model.nPrograms;
+	ensemble.nScenarios = nScenarios;
+	ensemble.quantile = min(1.0, max(0.0, quantile));
+	ensemble.inputs.assign(inputs.begin(), inputs.end());
+	ensemble.ideal.assign((size_t)nColumns * nScenarios, 0.0);
+
+	vector<double> nadir(ensemble.ideal.size());
+	ensemble_bounds(model, &inputs[0], nScenarios, &ensemble.ideal[0], &nadir[0]);
+
+	ensemble.single = single;
+	if (single) {
+		const int n = model.nPrograms;
+		init_float_ensemble(ensemble.floats, model, &inputs[0], nScenarios);
+
+		for (int c = 0; c < nColumns; c++) {
+			ensemble.floatError[c] = 0;
+			for (int s = 0; s < nScenarios; s++)
+				ensemble.floatError[c] = max(ensemble.floatError[c], ensemble.floats.error[(size_t)c * nScenarios + s] *
+						fabs(inputs[(size_t)(INPUT_BAU_SCALE(n) + c) * nScenarios + s]));
+		}
+	}
+}
+
+struct RegretJob {
+	RegretEnsemble* ensemble;
+	const PortfolioModel* model;
+	const uint8_t* opts;
+	double* objs;
+	int rank;       // order statistic taken from the regrets
+};
+
+static void regret_task(int task, int worker, void* context) {
+	RegretJob* job = (RegretJob*)context;
+	RegretEnsemble& ensemble = *job->ensemble;
+	const int n = ensemble.nPrograms;
+	const int nScenarios = ensemble.nScenarios;
+	RegretWorkspace& space = ensemble.workspaces[worker];
+
+	if (space.regrets.size() < (size_t)nScenarios) {
+		space.opts.resize(n);
+		space.outputs.resize((size_t)ENSEMBLE_OUTPUTS * nScenarios);
+		space.regrets.resize(nScenarios);
+		space.ranked.resize(nScenarios);
+		space.exact.resize(nScenarios);
+	}
+
+	int* opts = &space.opts[0];
+	double* outputs = &space.outputs[0];
+	double* regrets = &space.regrets[0];
+
+	for (int progIdx = 0; progIdx < n; progIdx++)
+		opts[progIdx] = job->opts[(size_t)task * n + progIdx];
+
+	if (!ensemble.single) {
+		evaluate_ensemble(*job->model, opts, &ensemble.inputs[0], nScenarios, outputs);
+
+		for (int c = 0; c < nColumns; c++) {
+			const double* f = outputs + (size_t)c * nScenarios;
+			const double* ideal = &ensemble.ideal[(size_t)c * nScenarios];
+
+			for (int s = 0; s < nScenarios; s++)
+				regrets[s] = f[s] - ideal[s];
+
+			nth_element(regrets, regrets + job->rank, regrets + nScenarios);
+			job->objs[task * nColumns + c] = regrets[job->rank];
+		}
+		return;
+	}
+
+	double* ranked = &space.ranked[0];
+	uint8_t* exact = &space.exact[0];
+
+	evaluate_ensemble_float(ensemble.floats, *job->model, opts, &ensemble.inputs[0], outputs);
+	memset(exact, 0, nScenarios);
+
+	for (int c = 0; c < nColumns; c++) {
+		const double* f = outputs + (size_t)c * nScenarios;
+		const double* ideal = &ensemble.ideal[(size_t)c * nScenarios];
+
+		for (int s = 0; s < nScenarios; s++)
+			regrets[s] = ranked[s] = f[s] - ideal[s];
+
+		nth_element(ranked, ranked + job->rank, ranked + nScenarios);
+		double estimate = ranked[job->rank];
+		double slack = 2 * ensemble.floatError[c];
+		int below = 0, nCandidates = 0;
+
+		for (int s = 0; s < nScenarios; s++) {
+			if (regrets[s] < estimate - slack) {
+				below++;
+			} else if (regrets[s] <= estimate + slack) {
+				if (!exact[s]) {
+					evaluate_ensemble_scenario(*job->model, opts, &ensemble.inputs[0], nScenarios, s, outputs);
+					exact[s] = 1;
+				}
+				ranked[nCandidates++] = f[s] - ideal[s];
+			}
+		}
+
+		nth_element(ranked, ranked + job->rank - below, ranked + nCandidates);
+		job->objs[task * nColumns + c] = ranked[job->rank - below];
+	}
+}
+
+void regret_objectives(RegretEnsemble& ensemble, const PortfolioModel& model, const uint8_t* opts,
+		int nSolutions, double* objs, ThreadPool* pool) {
+	const int nWorkers = (pool != NULL) ? pool->size() : 1;
+	const int nScenarios = ensemble.nScenarios;
+
+	if (ensemble.workspaces.size() < (size_t)nWorkers)
+		ensemble.workspaces.resize(nWorkers);
+
+	RegretJob job = { &ensemble, &model, opts, objs, 0 };
+	job.rank = max(0, min(nScenarios - 1, (int)ceil(ensemble.quantile * nScenarios - 1e-9) - 1));
+
+	if (pool != NULL) {
+		pool->run(nSolutions, regret_task, &job);
+	} else {
+		for (int i = 0; i < nSolutions; i++)
+			regret_task(i, 0, &job);
+	}
+}
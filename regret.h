@@ -0,0 +1,63 @@
+/*
+ * regret.h
+ *
+ *  Regret objectives over an ensemble of scenarios.  A portfolio's regret in
+ *  a scenario is how far each objective falls from the best value any
+ *  portfolio reaches in that scenario.  Since the objectives are sums over
+ *  programs, that ideal point is the sum of each program's best option, so
+ *  it is computed once when the ensemble is loaded and regret needs only one
+ *  pass over the scenarios per portfolio.  The objectives written are the
+ *  maximum regret over the scenarios, or a percentile of it.
+ *
+ *  With single set, the scenarios are evaluated by the float kernel.  The
+ *  regret written is still exactly the double path's: only scenarios whose
+ *  float regret is within twice the kernel's error bound of the float order
+ *  statistic can hold the true one, so those alone are evaluated again in
+ *  double and ranked, after the scenarios certainly below it.
+ *
+ *  The scenario matrix is a SharedBuffer and each worker's workspace a
+ *  LocalBuffer (placement.h), so with a pinned pool a large ensemble is
+ *  spread over the NUMA nodes rather than held by one.
+ */
+
+#ifndef REGRET_H_
+#define REGRET_H_
+
+#include <stdint.h>
+#include <vector>
+#include "ensemble.h"
+#include "threadpool.h"
+
+// One worker's scratch space, allocated and first written by that worker.
+struct RegretWorkspace {
+	LocalBuffer<int> opts;
+	LocalBuffer<double> outputs;
+	LocalBuffer<double> regrets;
+	LocalBuffer<double> ranked;
+	LocalBuffer<uint8_t> exact;     // scenarios already evaluated again in double
+};
+
+struct RegretEnsemble {
+	int nPrograms;
+	int nScenarios;
+	double quantile;                // 1 for the maximum regret
+	SharedBuffer<double> inputs;    // as in ensemble.h
+	SharedBuffer<double> ideal;     // nColumns ideal values per scenario, objective by objective
+	bool single;                    // evaluate in float, recheck near the order statistic
+	FloatEnsemble floats;
+	double floatError[nColumns];    // largest error of a float objective over the scenarios
+
+	std::vector<RegretWorkspace> workspaces;
+};
+
+// Computes the ideal point of every scenario.  quantile is in (0, 1]; the
+// regret written is the ceil(quantile*nScenarios)-th smallest.
+void init_regret(RegretEnsemble& ensemble, const PortfolioModel& model, const std::vector<double>& inputs,
+		int nScenarios, double quantile, bool single);
+
+// Writes the nColumns regret objectives of each of nSolutions portfolios,
+// given as consecutive rows of option indices, nColumns apart.
+void regret_objectives(RegretEnsemble& ensemble, const PortfolioModel& model, const uint8_t* opts,
+		int nSolutions, double* objs, ThreadPool* pool);
+
+#endif /* REGRET_H_ */
@@ -0,0 +1,143 @@
+/* repair.cpp
+ Greedy cost repair over options sorted by cost.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include "repair.h"
+
+using namespace std;
+
+void build_repair_table(const ScenarioTable& table, RepairTable& repair) {
+	repair.offsets = table.offsets;
+	repair.byCost.resize(table.offsets[table.nPrograms]);
+	repair.rank.resize(repair.byCost.size());
+
+	for (int progIdx = 0; progIdx < table.nPrograms; progIdx++) {
+		uint8_t* order = &repair.byCost[table.offsets[progIdx]];
+		int nOptions = table.options(progIdx);
+
+		for (int optIdx = 0; optIdx < nOptions; optIdx++)
+			order[optIdx] = (uint8_t)optIdx;
+
+		stable_sort(order, order + nOptions, [&table, progIdx](uint8_t a, uint8_t b) {
+			return table.row(progIdx, a)[COL_COST] < table.row(progIdx, b)[COL_COST];
+		});
+
+		for (int r = 0; r < nOptions; r++)
+			repair.rank[table.offsets[progIdx] + order[r]] = (uint8_t)r;
+	}
+}
+
+struct RepairMove {
+	double ratio;  // ss lost per unit of cost saved
+	int progIdx;
+	uint8_t from;  // option the move starts from, to detect stale entries
+	uint8_t to;
+
+	bool operator<(const RepairMove& other) const {
+		return ratio > other.ratio; // lowest ratio on top of the heap
+	}
+};
+
+// The best move for one program from option from; false if none is cheaper.
+static bool best_move(const ScenarioTable& table, const RepairTable& repair, int progIdx, uint8_t from,
+		RepairMove& move) {
+	const uint8_t* order = &repair.byCost[repair.offsets[progIdx]];
+	const double* current = table.row(progIdx, from);
+	bool found = false;
+
+	for (int r = repair.rank[repair.offsets[progIdx] + from] - 1; r >= 0; r--) {
+		const double* row = table.row(progIdx, order[r]);
+		double saved = current[COL_COST] - row[COL_COST];
+		if (saved <= 0) continue; // ties in cost save nothing
+
+		double ratio = (row[COL_SS] - current[COL_SS]) / saved;
+		if (!found || ratio < move.ratio) {
+			move.ratio = ratio;
+			move.progIdx = progIdx;
+			move.from = from;
+			move.to = order[r];
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+static double total_cost(const ScenarioTable& table, const uint8_t* opts) {
+	double cost = 0;
+
+	for (int progIdx = 0; progIdx < table.nPrograms; progIdx++)
+		cost += table.row(progIdx, opts[progIdx])[COL_COST];
+
+	return cost;
+}
+
+int repair_portfolio(const ScenarioTable& table, const RepairTable& repair, uint8_t* opts) {
+	double cost = total_cost(table, opts);
+	if (cost <= table.budget) return 0;
+
+	priority_queue<RepairMove> heap;
+	RepairMove move;
+	int moves = 0;
+
+	for (int progIdx = 0; progIdx < table.nPrograms; progIdx++)
+		if (best_move(table, repair, progIdx, opts[progIdx], move))
+			heap.push(move);
+
+	while (!heap.empty()) {
+		move = heap.top();
+		heap.pop();
+		if (opts[move.progIdx] != move.from) continue;
+
+		cost += table.row(move.progIdx, move.to)[COL_COST] - table.row(move.progIdx, move.from)[COL_COST];
+		opts[move.progIdx] = move.to;
+		moves++;
+
+		/* the running total drifts by rounding; confirm with the exact sum */
+		if (cost <= table.budget) {
+			cost = total_cost(table, opts);
+			if (cost <= table.budget) break;
+		}
+
+		if (best_move(table, repair, move.progIdx, move.to, move))
+			heap.push(move);
+	}
+
+	return moves;
+}
+
+struct RepairJob {
+	const ScenarioTable* table;
+	const RepairTable* repair;
+	uint8_t* opts;
+	atomic<int> changed;
+};
+
+static void repair_task(int task, int worker, void* context) {
+	RepairJob* job = (RepairJob*)context;
+
+	if (repair_portfolio(*job->table, *job->repair, job->opts + (size_t)task * job->table->nPrograms) > 0)
+		job->changed++;
+}
+
+int repair_batch(const ScenarioTable& table, const RepairTable& repair, uint8_t* opts, int nSolutions,
+		ThreadPool* pool) {
+	RepairJob job;
+
+	job.table = &table;
+	job.repair = &repair;
+	job.opts = opts;
+	job.changed = 0;
+
+	if (pool != NULL) {
+		pool->run(nSolutions, repair_task, &job);
+	} else {
+		for (int i = 0; i < nSolutions; i++)
+			repair_task(i, 0, &job);
+	}
+
+	return job.changed;
+}
@@ -0,0 +1,42 @@
+/*
+ * repair.h
+ *
+ *  Greedy repair of portfolios that exceed the budget.  While a portfolio
+ *  is over budget, one program is moved to a cheaper option: the move with
+ *  the smallest increase in ss per unit of cost saved over all programs and
+ *  all of their cheaper options.  Each program's options are kept sorted by
+ *  cost, so the cheaper options of the current one are a prefix of that
+ *  order, and the best move of every program sits in a heap that is updated
+ *  only for the program just moved.
+ *
+ *  Only the total budget is repaired; yearly budgets are left to the
+ *  optimizer.
+ */
+
+#ifndef REPAIR_H_
+#define REPAIR_H_
+
+#include <stdint.h>
+#include <vector>
+#include "portfolio.h"
+#include "threadpool.h"
+
+struct RepairTable {
+	std::vector<uint32_t> offsets; // as in the scenario table
+	std::vector<uint8_t> byCost;   // each program's options, cheapest first
+	std::vector<uint8_t> rank;     // position of each option in byCost
+};
+
+void build_repair_table(const ScenarioTable& table, RepairTable& repair);
+
+// Repairs one portfolio in place; returns the number of moves made.  A
+// portfolio that stays over budget with every program at its cheapest option
+// is returned that way.
+int repair_portfolio(const ScenarioTable& table, const RepairTable& repair, uint8_t* opts);
+
+// Repairs nSolutions portfolios stored as in evaluate_batch; returns how many
+// were changed.
+int repair_batch(const ScenarioTable& table, const RepairTable& repair, uint8_t* opts, int nSolutions,
+		ThreadPool* pool);
+
+#endif /* REPAIR_H_ */
@@ -0,0 +1,35 @@
+/* simd.cpp
+ Selection of the instruction set the kernels run at.
+ */
+
+#include <string.h>
+#include "simd.h"
+
+static const char* levelNames[N_SIMD_LEVELS] = { "sse2", "avx2", "avx512" };
+
+SimdLevel supported_simd_level() {
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+	return SIMD_SSE2;
+}
+
+SimdLevel simdLevel = supported_simd_level();
+
+const char* simd_level_name(SimdLevel level) {
+	return levelNames[level];
+}
+
+bool set_simd_level(const char* name) {
+	for (int level = 0; level < N_SIMD_LEVELS; level++) {
+		if (strcmp(name, levelNames[level]) == 0 && level <= supported_simd_level()) {
+			simdLevel = (SimdLevel)level;
+			return true;
+		}
+	}
+
+	return false;
+}
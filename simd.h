@@ -0,0 +1,112 @@
+/*
+ * simd.h
+ *
+ *  Portable short vectors built on the GCC vector extensions.  Arithmetic on
+ *  these types compiles to the widest vector instructions the target allows
+ *  (a v4df is two SSE2 registers on baseline x86-64, one AVX register when
+ *  built with -mavx; a v8sf holds twice as many floats in the same space).
+ *  Loads and stores go through memcpy so they are valid for any array,
+ *  aligned or not.  The helpers have internal linkage since translation
+ *  units built for different instruction sets pass these types differently;
+ *  the makefile silences GCC's -Wpsabi note about that for the objects
+ *  that call them.
+ *
+ *  The hot kernels are built once per instruction set in SimdLevel: the
+ *  body is a SIMD_KERNEL (always inlined), wrapped in one function per
+ *  level carrying that level's SIMD_TARGET, and SIMD_DISPATCH calls the
+ *  wrapper for simdLevel.  Kernels that vectorize across independent lanes
+ *  are templates on the vector type and take the 64-byte types at
+ *  SIMD_AVX512.  The makefile builds with -ffp-contract=off, so no level
+ *  fuses a multiply and add and every level gives the same results, bit
+ *  for bit.
+ */
+
+#ifndef SIMD_H_
+#define SIMD_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define SIMD_WIDTH 4 // doubles per v4df
+#define FLOAT_WIDTH 8 // floats per v8sf
+
+typedef double v4df __attribute__((vector_size(32)));
+typedef double v8df __attribute__((vector_size(64)));
+typedef float v8sf __attribute__((vector_size(32)));
+typedef float v16sf __attribute__((vector_size(64)));
+typedef int8_t v16qi __attribute__((vector_size(16)));
+typedef uint8_t v16qu __attribute__((vector_size(16)));
+typedef int16_t v8hi __attribute__((vector_size(16)));
+typedef int32_t v4si __attribute__((vector_size(16)));
+typedef int32_t v8si __attribute__((vector_size(32)));
+typedef int32_t v16si __attribute__((vector_size(64)));
+typedef int64_t v2di __attribute__((vector_size(16)));
+
+enum SimdLevel { SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, N_SIMD_LEVELS };
+
+// The level the kernels run at: the highest the CPU supports, unless
+// lowered with set_simd_level.
+extern SimdLevel simdLevel;
+
+SimdLevel supported_simd_level();
+
+const char* simd_level_name(SimdLevel level);
+
+// Selects a level by name (sse2, avx2 or avx512).  Returns false if the name
+// is unknown or the CPU does not support that level.
+bool set_simd_level(const char* name);
+
+#define SIMD_KERNEL static inline __attribute__((always_inline))
+#define SIMD_TARGET_SSE2
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+
+// Calls name_sse2, name_avx2 or name_avx512 with args, a parenthesized list.
+#define SIMD_DISPATCH(name, args) \
+	do { \
+		switch (simdLevel) { \
+		case SIMD_AVX512: name##_avx512 args; break; \
+		case SIMD_AVX2: name##_avx2 args; break; \
+		default: name##_sse2 args; break; \
+		} \
+	} while (0)
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+static inline v4df load4(const double* p) {
+	v4df v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline void store4(double* p, const v4df& v) {
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline v8sf load8f(const float* p) {
+	v8sf v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline void store8f(float* p, const v8sf& v) {
+	memcpy(p, &v, sizeof(v));
+}
+
+// Loads and stores of any of the vector types, for kernels templated on one.
+template <typename V, typename T>
+static inline V loadv(const T* p) {
+	V v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+template <typename V, typename T>
+static inline void storev(T* p, const V& v) {
+	memcpy(p, &v, sizeof(v));
+}
+
+#pragma GCC diagnostic pop
+
+#endif /* SIMD_H_ */
@@ -0,0 +1,268 @@
+/* sobol.cpp
+ Saltelli sampling and streaming estimation of Sobol indices.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_01.hpp>
+#include "sobol.h"
+#include "simd.h"
+
+using namespace std;
+
+// Running sums per replicate and output: the weight, the first two moments of
+// f(A) and f(B), then one first-order and one total sum per input.
+#define TERM_WEIGHT 0
+#define TERM_A 1
+#define TERM_AA 2
+#define TERM_B 3
+#define TERM_BB 4
+#define TERM_FIRST 5
+#define TERM_TOTAL(nInputs) (5 + (nInputs))
+#define TERMS(nInputs) (5 + 2 * (nInputs))
+
+// Allocated and first written by the worker using it (placement.h).
+struct SobolWorker {
+	LocalBuffer<double> inputs;  // scenarios of one chunk: A, B, then A with column i from B
+	LocalBuffer<double> outputs;
+	LocalBuffer<double> terms;   // per base sample, the summands of every output
+	LocalBuffer<double> weights; // bootstrap weight of each base sample
+};
+
+struct SobolJob {
+	const PortfolioModel* model;
+	const int* opts;
+	const SobolOptions* options;
+	int nInputs;
+	int width;              // summands per base sample, padded to SIMD_WIDTH
+	double center[ENSEMBLE_OUTPUTS]; // outputs at the midpoint, subtracted for accuracy
+	int firstTask;          // first chunk of the current wave
+	vector<SobolWorker> workers;
+	vector<double> taskSums; // sums of each chunk of the wave, replicate by replicate
+};
+
+static uint64_t splitmix64(uint64_t x) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+// Poisson(1) count for base sample s in bootstrap replicate r.
+static int poisson_weight(unsigned int seed, int r, int s) {
+	uint64_t h = splitmix64(splitmix64(((uint64_t)seed << 32) ^ (uint64_t)r) ^ (uint64_t)s);
+	double u = (h >> 11) * (1.0 / 9007199254740992.0);
+	double p = exp(-1.0), cdf = p;
+	int k = 0;
+
+	while (u >= cdf && k < 16) {
+		k++;
+		p /= k;
+		cdf += p;
+	}
+
+	return k;
+}
+
+// sums[c] = the sum over the m rows of weights[s] * terms[s*width + c].
+SIMD_KERNEL void weighted_sums_kernel(const double* weights, const double* terms, int m, int width, double* sums) {
+	for (int c = 0; c < width; c += SIMD_WIDTH) {
+		v4df acc = { 0.0, 0.0, 0.0, 0.0 };
+
+		for (int s = 0; s < m; s++)
+			if (weights[s] != 0.0)
+				acc += weights[s] * load4(&terms[(size_t)s * width + c]);
+
+		store4(sums + c, acc);
+	}
+}
+
+static void weighted_sums_sse2(const double* weights, const double* terms, int m, int width, double* sums) {
+	weighted_sums_kernel(weights, terms, m, width, sums);
+}
+
+SIMD_TARGET_AVX2 static void weighted_sums_avx2(const double* weights, const double* terms, int m, int width,
+		double* sums) {
+	weighted_sums_kernel(weights, terms, m, width, sums);
+}
+
+SIMD_TARGET_AVX512 static void weighted_sums_avx512(const double* weights, const double* terms, int m, int width,
+		double* sums) {
+	weighted_sums_kernel(weights, terms, m, width, sums);
+}
+
+static void sobol_task(int slot, int worker, void* context) {
+	SobolJob* job = (SobolJob*)context;
+	const int task = job->firstTask + slot;
+	const SobolOptions& options = *job->options;
+	const int k = job->nInputs;
+	const int first = task * SOBOL_CHUNK;
+	const int m = min(SOBOL_CHUNK, options.nBase - first);
+	const int nScenarios = m * (k + 2);
+	const int nReplicates = 1 + options.nBootstrap;
+	const int width = job->width;
+	SobolWorker& w = job->workers[worker];
+
+	if (w.inputs.empty()) {
+		w.inputs.resize((size_t)k * SOBOL_CHUNK * (k + 2));
+		w.outputs.resize((size_t)ENSEMBLE_OUTPUTS * SOBOL_CHUNK * (k + 2));
+		w.terms.assign((size_t)SOBOL_CHUNK * width, 0.0);
+		w.weights.resize(SOBOL_CHUNK);
+	}
+
+	/* A and B, then the k mixed matrices */
+	boost::random::mt19937 rng(options.seed * 1000003u + task);
+	boost::random::uniform_01<double> uniform;
+	double* x = &w.inputs[0];
+
+	for (int s = 0; s < m; s++) {
+		for (int i = 0; i < k; i++) {
+			double range = options.upper[i] - options.lower[i];
+			x[(size_t)i * nScenarios + s] = options.lower[i] + range * uniform(rng);
+			x[(size_t)i * nScenarios + m + s] = options.lower[i] + range * uniform(rng);
+		}
+	}
+
+	for (int j = 0; j < k; j++) {
+		for (int i = 0; i < k; i++) {
+			const double* src = x + (size_t)i * nScenarios + (i == j ? m : 0);
+			copy(src, src + m, x + (size_t)i * nScenarios + (2 + j) * m);
+		}
+	}
+
+	evaluate_ensemble(*job->model, job->opts, x, nScenarios, &w.outputs[0]);
+
+	/* summands of every estimator, one row per base sample */
+	for (int s = 0; s < m; s++) {
+		double* t = &w.terms[(size_t)s * width];
+
+		for (int o = 0; o < ENSEMBLE_OUTPUTS; o++, t += TERMS(k)) {
+			const double* f = &w.outputs[(size_t)o * nScenarios];
+			double a = f[s] - job->center[o];
+			double b = f[m + s] - job->center[o];
+
+			t[TERM_WEIGHT] = 1.0;
+			t[TERM_A] = a;
+			t[TERM_AA] = a * a;
+			t[TERM_B] = b;
+			t[TERM_BB] = b * b;
+
+			for (int i = 0; i < k; i++) {
+				double d = f[(2 + i) * m + s] - f[s];
+				t[TERM_FIRST + i] = b * d;
+				t[TERM_TOTAL(k) + i] = d * d;
+			}
+		}
+	}
+
+	/* weighted column sums of the summands, one pass per replicate */
+	for (int r = 0; r < nReplicates; r++) {
+		double* sums = &job->taskSums[((size_t)slot * nReplicates + r) * width];
+
+		for (int s = 0; s < m; s++)
+			w.weights[s] = (r == 0) ? 1.0 : poisson_weight(options.seed, r, first + s);
+
+		SIMD_DISPATCH(weighted_sums, (&w.weights[0], &w.terms[0], m, width, sums));
+	}
+}
+
+// First-order and total indices of every output from one replicate's sums.
+static void indices(const double* sums, int k, double* variance, double* first, double* total) {
+	for (int o = 0; o < ENSEMBLE_OUTPUTS; o++) {
+		const double* t = sums + o * TERMS(k);
+		double n = t[TERM_WEIGHT];
+		double mean = (t[TERM_A] + t[TERM_B]) / (2 * n);
+		double v = (t[TERM_AA] + t[TERM_BB]) / (2 * n) - mean * mean;
+
+		variance[o] = v;
+		for (int i = 0; i < k; i++) {
+			first[o * k + i] = (v > 0) ? t[TERM_FIRST + i] / n / v : 0.0;
+			total[o * k + i] = (v > 0) ? t[TERM_TOTAL(k) + i] / (2 * n) / v : 0.0;
+		}
+	}
+}
+
+static double percentile(vector<double>& values, double q) {
+	size_t idx = (size_t)min((double)values.size() - 1, max(0.0, floor(q * values.size())));
+	nth_element(values.begin(), values.begin() + idx, values.end());
+	return values[idx];
+}
+
+void sobol_analysis(const PortfolioModel& model, const int* opts, const SobolOptions& options,
+		SobolResult& result, ThreadPool* pool) {
+	const int k = SCENARIO_INPUTS(model.nPrograms);
+	const int nReplicates = 1 + options.nBootstrap;
+	const int nTasks = (options.nBase + SOBOL_CHUNK - 1) / SOBOL_CHUNK;
+	const int nWorkers = (pool != NULL) ? pool->size() : 1;
+	SobolJob job;
+
+	job.model = &model;
+	job.opts = opts;
+	job.options = &options;
+	job.nInputs = k;
+	job.width = (ENSEMBLE_OUTPUTS * TERMS(k) + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	job.workers.resize(nWorkers);
+
+	vector<double> midpoint(k);
+	for (int i = 0; i < k; i++)
+		midpoint[i] = 0.5 * (options.lower[i] + options.upper[i]);
+	evaluate_ensemble(model, opts, &midpoint[0], 1, job.center);
+
+	/* chunk sums are folded in chunk order after each wave, so the result
+	 * does not depend on the number of threads or on scheduling */
+	const size_t sumsSize = (size_t)nReplicates * job.width;
+	vector<double> sums(sumsSize, 0.0);
+	job.taskSums.resize(min(nTasks, SOBOL_WAVE) * sumsSize);
+
+	for (job.firstTask = 0; job.firstTask < nTasks; job.firstTask += SOBOL_WAVE) {
+		const int nWave = min(SOBOL_WAVE, nTasks - job.firstTask);
+
+		if (pool != NULL) {
+			pool->run(nWave, sobol_task, &job);
+		} else {
+			for (int slot = 0; slot < nWave; slot++)
+				sobol_task(slot, 0, &job);
+		}
+
+		for (int slot = 0; slot < nWave; slot++) {
+			const double* taskSums = &job.taskSums[slot * sumsSize];
+			for (size_t c = 0; c < sumsSize; c += SIMD_WIDTH)
+				store4(&sums[c], load4(&sums[c]) + load4(taskSums + c));
+		}
+	}
+
+	const size_t nIndices = (size_t)ENSEMBLE_OUTPUTS * k;
+	result.nInputs = k;
+	result.variance.resize(ENSEMBLE_OUTPUTS);
+	result.first.resize(nIndices);
+	result.total.resize(nIndices);
+	result.firstLow.assign(nIndices, NAN);
+	result.firstHigh.assign(nIndices, NAN);
+	result.totalLow.assign(nIndices, NAN);
+	result.totalHigh.assign(nIndices, NAN);
+	indices(&sums[0], k, &result.variance[0], &result.first[0], &result.total[0]);
+
+	if (options.nBootstrap == 0) return;
+
+	/* percentile intervals over the replicates */
+	vector<double> variance(ENSEMBLE_OUTPUTS);
+	vector<double> first((size_t)options.nBootstrap * nIndices), total(first.size());
+	for (int r = 1; r < nReplicates; r++)
+		indices(&sums[(size_t)r * job.width], k, &variance[0], &first[(r - 1) * nIndices], &total[(r - 1) * nIndices]);
+
+	const double alpha = 1 - options.confidence;
+	vector<double> values(options.nBootstrap);
+	for (size_t idx = 0; idx < nIndices; idx++) {
+		for (int r = 0; r < options.nBootstrap; r++)
+			values[r] = first[r * nIndices + idx];
+		result.firstLow[idx] = percentile(values, alpha / 2);
+		result.firstHigh[idx] = percentile(values, 1 - alpha / 2);
+
+		for (int r = 0; r < options.nBootstrap; r++)
+			values[r] = total[r * nIndices + idx];
+		result.totalLow[idx] = percentile(values, alpha / 2);
+		result.totalHigh[idx] = percentile(values, 1 - alpha / 2);
+	}
+}
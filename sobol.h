@@ -0,0 +1,56 @@
+/*
+ * sobol.h
+ *
+ *  Sobol global sensitivity of a portfolio's outputs (the 3 objectives and
+ *  the budget constraint) to the scenario inputs of ensemble.h.  Inputs are
+ *  sampled uniformly over their ranges in Saltelli's scheme: base matrices A
+ *  and B plus, for every input i, A with column i taken from B, for
+ *  nBase*(nInputs+2) evaluations.  First-order indices use the Saltelli
+ *  (2010) estimator and total indices Jansen's.
+ *
+ *  The base samples are processed in chunks spread over a thread pool, in
+ *  waves of SOBOL_WAVE chunks, so memory does not grow with nBase.  Each
+ *  chunk sums its samples in order from zero, and after each wave the chunk
+ *  sums are added to the running sums in chunk order; results are therefore
+ *  bitwise identical for any number of threads.  Bootstrap confidence
+ *  intervals come from the same pass: each replicate weights every base
+ *  sample by a Poisson(1) count (the streaming form of resampling with
+ *  replacement), drawn from a hash of the sample index so the replicates do
+ *  not depend on how chunks are assigned to threads either.
+ */
+
+#ifndef SOBOL_H_
+#define SOBOL_H_
+
+#include <vector>
+#include "ensemble.h"
+#include "threadpool.h"
+
+#define SOBOL_CHUNK 256 // base samples per task
+#define SOBOL_WAVE 64   // tasks whose sums are held before being folded in
+
+struct SobolOptions {
+	int nBase;                 // rows of A and B
+	int nBootstrap;            // bootstrap replicates, 0 for no intervals
+	double confidence;         // level of the bootstrap intervals, e.g. 0.95
+	unsigned int seed;
+	std::vector<double> lower; // range of each input
+	std::vector<double> upper;
+};
+
+// Index of output o and input i at [o*nInputs + i].
+struct SobolResult {
+	int nInputs;
+	std::vector<double> variance; // per output
+	std::vector<double> first;
+	std::vector<double> firstLow;
+	std::vector<double> firstHigh;
+	std::vector<double> total;
+	std::vector<double> totalLow;
+	std::vector<double> totalHigh;
+};
+
+void sobol_analysis(const PortfolioModel& model, const int* opts, const SobolOptions& options,
+		SobolResult& result, ThreadPool* pool);
+
+#endif /* SOBOL_H_ */
@@ -0,0 +1,123 @@
+/* stats.cpp
+ Interval summaries of the request loop instrumentation.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+#include "moeaframework.h"
+
+Stats stats;
+
+static const char* phaseNames[N_PHASES] = { "read", "parse", "evaluate", "format", "flush" };
+
+static double now(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void emit(const char* format, ...) {
+	va_list arguments;
+	va_start(arguments, format);
+
+	if (stats.file != NULL) {
+		vfprintf(stats.file, format, arguments);
+	} else {
+		char line[256];
+		vsnprintf(line, sizeof(line), format, arguments);
+		MOEA_Debug("%s", line);
+	}
+
+	va_end(arguments);
+}
+
+// Smallest tick count that falls in bucket.
+static uint64_t bucket_floor(int bucket) {
+	if (bucket < (1 << STATS_SUB_BITS)) return bucket;
+
+	int msb = (bucket >> STATS_SUB_BITS) + STATS_SUB_BITS - 1;
+	uint64_t sub = bucket & ((1 << STATS_SUB_BITS) - 1);
+	return ((1ULL << STATS_SUB_BITS) | sub) << (msb - STATS_SUB_BITS);
+}
+
+// Middle of the bucket holding the q quantile.
+static double quantile(const PhaseHistogram& h, double q) {
+	uint64_t rank = (uint64_t)(q * (h.count - 1)), seen = 0;
+
+	for (int b = 0; b < STATS_BUCKETS; b++) {
+		seen += h.buckets[b];
+		if (seen > rank)
+			return 0.5 * (bucket_floor(b) + (b + 1 < STATS_BUCKETS ? bucket_floor(b + 1) : h.max));
+	}
+
+	return h.max;
+}
+
+void stats_init(double interval, const char* filename) {
+	memset(&stats, 0, sizeof(stats));
+
+	if (filename != NULL && (stats.file = fopen(filename, "a")) == NULL) {
+		fprintf(stderr, "Unable to open %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	stats.enabled = true;
+	stats.interval = interval;
+	stats.startTime = now(CLOCK_MONOTONIC);
+	stats.startTick = stats_tick();
+	stats.intervalStart = stats.startTime;
+	stats.nextEmit = stats.startTime + interval;
+	stats.lastTick = stats.startTick;
+}
+
+static void emit_summary(double time) {
+	double elapsed = time - stats.intervalStart;
+	double nsPerTick = 1e9 * (time - stats.startTime) / (double)(stats_tick() - stats.startTick);
+	unsigned long bytesIn = MOEA_Bytes_read - stats.bytesIn, bytesOut = MOEA_Bytes_written - stats.bytesOut;
+
+	emit("stats: %.2f s, %lu solutions (%.0f/s), %lu batches, %lu bytes in, %lu bytes out, %lu cache hits, "
+			"%lu misses\n", elapsed, (unsigned long)stats.counters[COUNT_SOLUTIONS],
+			stats.counters[COUNT_SOLUTIONS] / (elapsed > 0 ? elapsed : 1),
+			(unsigned long)stats.counters[COUNT_BATCHES], bytesIn, bytesOut,
+			(unsigned long)stats.counters[COUNT_CACHE_HITS], (unsigned long)stats.counters[COUNT_CACHE_MISSES]);
+	emit("stats: %-9s %10s %10s %10s %10s %10s %10s\n", "phase", "count", "mean-ns", "p50", "p90", "p99", "max");
+
+	for (int p = 0; p < N_PHASES; p++) {
+		const PhaseHistogram& h = stats.phases[p];
+		if (h.count == 0) continue;
+
+		emit("stats: %-9s %10lu %10.0f %10.0f %10.0f %10.0f %10.0f\n", phaseNames[p], (unsigned long)h.count,
+				nsPerTick * h.total / h.count, nsPerTick * quantile(h, 0.5), nsPerTick * quantile(h, 0.9),
+				nsPerTick * quantile(h, 0.99), nsPerTick * h.max);
+	}
+
+	if (stats.file != NULL) fflush(stats.file);
+
+	/* the next interval starts from empty histograms */
+	memset(stats.phases, 0, sizeof(stats.phases));
+	memset(stats.counters, 0, sizeof(stats.counters));
+	stats.bytesIn = MOEA_Bytes_read;
+	stats.bytesOut = MOEA_Bytes_written;
+	stats.intervalStart = time;
+}
+
+// Polled after every flush, so it checks the cheap coarse clock.
+void stats_poll() {
+	if (now(CLOCK_MONOTONIC_COARSE) < stats.nextEmit) return;
+
+	double time = now(CLOCK_MONOTONIC);
+	emit_summary(time);
+	while (stats.nextEmit <= time)
+		stats.nextEmit += stats.interval;
+}
+
+void stats_finish() {
+	if (!stats.enabled) return;
+
+	emit_summary(now(CLOCK_MONOTONIC));
+	if (stats.file != NULL) fclose(stats.file);
+	stats.enabled = false;
+}
@@ -0,0 +1,125 @@
+/*
+ * stats.h
+ *
+ *  Instrumentation of the request loops: the time of each phase (reading a
+ *  line, parsing it, evaluating, formatting the result and flushing) taken
+ *  from the time stamp counter into a log-linear histogram per phase, and
+ *  counters of solutions, batches, bytes and table cache hits.
+ *
+ *  Built only with PORTFOLIO_STATS defined (make DEFINES=-DPORTFOLIO_STATS);
+ *  otherwise the STATS_ macros expand to nothing.  When built in, recording
+ *  starts with stats_init, and a summary of each interval is emitted through
+ *  MOEA_Debug or to a file.
+ *
+ *  Phases are laps: STATS_LAP(phase) charges the time since the previous lap
+ *  to phase, so the phases of a loop add up to its wall time.  Time spent
+ *  waiting for the driver is charged to the read phase.
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+enum StatsPhase {
+	PHASE_READ,
+	PHASE_PARSE,
+	PHASE_EVALUATE,
+	PHASE_FORMAT,
+	PHASE_FLUSH,
+	N_PHASES
+};
+
+enum StatsCounter {
+	COUNT_SOLUTIONS,
+	COUNT_BATCHES,
+	COUNT_CACHE_HITS,
+	COUNT_CACHE_MISSES,
+	N_COUNTERS
+};
+
+// Values below 2^STATS_SUB_BITS have a bucket each; above that every power of
+// two is split into 2^STATS_SUB_BITS buckets, so a bucket is within 6% of its
+// values.
+#define STATS_SUB_BITS 4
+#define STATS_BUCKETS ((64 - STATS_SUB_BITS + 1) << STATS_SUB_BITS)
+
+struct PhaseHistogram {
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+	uint32_t buckets[STATS_BUCKETS];
+};
+
+struct Stats {
+	bool enabled;
+	double interval;         // seconds between summaries
+	FILE* file;              // NULL for MOEA_Debug
+	uint64_t lastTick;       // end of the previous lap
+	double nextEmit;
+	double startTime;        // calibration of ticks against the monotonic clock
+	uint64_t startTick;
+	double intervalStart;
+	unsigned long bytesIn;   // MOEA_Bytes_read and MOEA_Bytes_written at the
+	unsigned long bytesOut;  // start of the interval
+	PhaseHistogram phases[N_PHASES];
+	uint64_t counters[N_COUNTERS];
+};
+
+extern Stats stats;
+
+static inline uint64_t stats_tick() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline int stats_bucket(uint64_t ticks) {
+	if (ticks < (1 << STATS_SUB_BITS)) return (int)ticks;
+
+	int msb = 63 - __builtin_clzll(ticks);
+	return ((msb - STATS_SUB_BITS + 1) << STATS_SUB_BITS) +
+			(int)((ticks >> (msb - STATS_SUB_BITS)) & ((1 << STATS_SUB_BITS) - 1));
+}
+
+static inline void stats_lap(StatsPhase phase) {
+	uint64_t tick = stats_tick();
+	uint64_t ticks = tick - stats.lastTick;
+	PhaseHistogram& h = stats.phases[phase];
+
+	h.count++;
+	h.total += ticks;
+	if (ticks > h.max) h.max = ticks;
+	h.buckets[stats_bucket(ticks)]++;
+	stats.lastTick = tick;
+}
+
+// Starts recording, with a summary every interval seconds written to
+// filename, or through MOEA_Debug if filename is NULL.
+void stats_init(double interval, const char* filename);
+
+// Emits a summary if the interval has passed.
+void stats_poll();
+
+// Emits the summary of the last, partial interval.
+void stats_finish();
+
+#ifdef PORTFOLIO_STATS
+#define STATS_START() do { if (stats.enabled) stats.lastTick = stats_tick(); } while (0)
+#define STATS_LAP(phase) do { if (stats.enabled) stats_lap(phase); } while (0)
+#define STATS_COUNT(counter, n) do { if (stats.enabled) stats.counters[counter] += (n); } while (0)
+#define STATS_POLL() do { if (stats.enabled) stats_poll(); } while (0)
+#else
+#define STATS_START() do { } while (0)
+#define STATS_LAP(phase) do { } while (0)
+#define STATS_COUNT(counter, n) do { } while (0)
+#define STATS_POLL() do { } while (0)
+#endif
+
+#endif /* STATS_H_ */
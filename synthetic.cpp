@@ -0,0 +1,74 @@
+/* synthetic.cpp
+ Random portfolio models shaped like the built-in one.
+ */
+
+#include <math.h>
+#include <vector>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include <boost/random/lognormal_distribution.hpp>
+#include "synthetic.h"
+
+void synthetic_model(PortfolioModel& model, int nPrograms, int minOptions, int maxOptions,
+		double budgetFraction, unsigned int seed, int nYears) {
+	boost::random::mt19937 rng(seed);
+	boost::random::uniform_int_distribution<int> optionCount(minOptions, maxOptions);
+	boost::random::uniform_real_distribution<double> unit(0.0, 1.0);
+	boost::random::lognormal_distribution<double> programCost(4.5, 1.5);
+	double fullCost = 0;
+	std::vector<double> profile(nYears), fullYearCost(nYears, 0.0);
+
+	model.release();
+	model.nPrograms = nPrograms;
+	model.nYears = nYears;
+	model.offsetStorage.assign(1, 0);
+
+	for (int progIdx = 0; progIdx < nPrograms; progIdx++) {
+		int options = optionCount(rng);
+		double cost = floor(programCost(rng) * 1000) / 1000;
+		double bauMax = 10 * ceil(10 * unit(rng));
+		double ssMax = 10 * ceil(10 * unit(rng));
+		double bau = 0, ss = 0, profileTotal = 0;
+
+		/* the program's spend profile across the years */
+		for (int y = 0; y < nYears; y++)
+			profileTotal += (profile[y] = 0.2 + unit(rng));
+
+		for (int optIdx = 0; optIdx < options; optIdx++) {
+			double remaining = (options == 1) ? 1.0 : 1.0 - (double)optIdx / (options - 1);
+			double optionCost = (optIdx == options - 1) ? 0.0 : floor(cost * remaining * (0.8 + 0.2 * unit(rng)) * 1000) / 1000;
+
+			/* bau and ss are non-decreasing integers reaching their maximum at cancellation */
+			bau = (optIdx == options - 1) ? bauMax : floor(bau + (bauMax - bau) * unit(rng) * 0.6);
+			ss = (optIdx == options - 1) ? ssMax : floor(ss + (ssMax - ss) * unit(rng) * 0.6);
+
+			/* split the cost over the years, the total being the sum of the yearly costs */
+			if (nYears > 0) {
+				double total = 0;
+
+				for (int y = 0; y < nYears; y++) {
+					double yearCost = floor(optionCost * profile[y] / profileTotal * 1000) / 1000;
+					model.yearStorage.push_back(yearCost);
+					total += yearCost;
+					if (optIdx == 0) fullYearCost[y] += yearCost;
+				}
+
+				optionCost = total;
+			}
+
+			model.storage.push_back(bau);
+			model.storage.push_back(ss);
+			model.storage.push_back(optionCost);
+		}
+
+		fullCost += model.storage[model.storage.size() - options * nColumns + COL_COST];
+		model.offsetStorage.push_back(model.offsetStorage.back() + options);
+	}
+
+	model.nRows = model.offsetStorage.back();
+	model.costThreshold = floor(fullCost * budgetFraction);
+	for (int y = 0; y < nYears; y++)
+		model.yearThresholdStorage.push_back(floor(fullYearCost[y] * budgetFraction));
+	model.attach_storage();
+}
@@ -0,0 +1,22 @@
+/*
+ * synthetic.h
+ *
+ *  Generator of synthetic portfolio models for scaling studies.  Programs get
+ *  a random number of options; option 0 is the full program (highest cost,
+ *  lowest bau and ss) and the last option cancels it (no cost, highest bau
+ *  and ss), mirroring the structure of the built-in model.
+ */
+
+#ifndef SYNTHETIC_H_
+#define SYNTHETIC_H_
+
+#include "model.h"
+
+// The cost threshold is set to budgetFraction of the cost of funding every
+// program fully.  With nYears > 0 each option's cost is spread over the years
+// with a random spend profile and the yearly thresholds take the same
+// fraction of each year's full-funding cost.
+void synthetic_model(PortfolioModel& model, int nPrograms, int minOptions, int maxOptions,
+		double budgetFraction, unsigned int seed, int nYears = 0);
+
+#endif /* SYNTHETIC_H_ */
@@ -0,0 +1,84 @@
+/* threadpool.cpp
+ Persistent worker threads for the parallel evaluation paths.
+ */
+
+#include "threadpool.h"
+#include "placement.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int nThreads, bool pinned) :
+		generation(0), active(0), stopping(false), pinned(pinned), task(NULL), context(NULL), nTasks(0), next(0) {
+	for (int worker = 1; worker < nThreads; worker++)
+		workers.push_back(thread(&ThreadPool::work, this, worker));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void ThreadPool::drain(int worker) {
+	for (int i = next++; i < nTasks; i = next++)
+		task(i, worker, context);
+}
+
+void ThreadPool::work(int worker) {
+	unsigned long seen = 0;
+
+	if (pinned)
+		pin_worker(worker);
+
+	while (true) {
+		{
+			unique_lock<std::mutex> lock(mutex);
+			while (!stopping && generation == seen)
+				wake.wait(lock);
+			if (stopping) return;
+			seen = generation;
+		}
+
+		drain(worker);
+
+		{
+			lock_guard<std::mutex> lock(mutex);
+			if (--active == 0) done.notify_one();
+		}
+	}
+}
+
+void ThreadPool::run(int nTasks, ThreadTask task, void* context) {
+	if (workers.empty() || nTasks == 1) {
+		for (int i = 0; i < nTasks; i++)
+			task(i, 0, context);
+		return;
+	}
+
+	{
+		lock_guard<std::mutex> lock(mutex);
+		this->task = task;
+		this->context = context;
+		this->nTasks = nTasks;
+		next = 0;
+		active = workers.size();
+		generation++;
+	}
+
+	wake.notify_all();
+	drain(0);
+
+	unique_lock<std::mutex> lock(mutex);
+	while (active > 0)
+		done.wait(lock);
+}
+
+int hardware_threads() {
+	unsigned int n = thread::hardware_concurrency();
+	return n == 0 ? 1 : (int)n;
+}
@@ -0,0 +1,62 @@
+/*
+ * threadpool.h
+ *
+ *  A small persistent pool of worker threads.  run() hands out task indices
+ *  to the workers and the calling thread, returning once every task is done,
+ *  so the cost of a parallel section is a wake-up rather than thread creation.
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Task body: the task index and the index of the worker running it, which is
+// below size() and can be used to select per-worker scratch space.
+typedef void (*ThreadTask)(int task, int worker, void* context);
+
+class ThreadPool {
+public:
+	// nThreads counts the calling thread; a pool of 1 runs everything inline.
+	// With pinned set, each worker thread w >= 1 stays on one CPU, chosen by
+	// pin_worker in placement.h.  The calling thread, worker 0, is left
+	// unpinned, so neither it nor the threads it starts later are confined.
+	explicit ThreadPool(int nThreads, bool pinned = false);
+	~ThreadPool();
+
+	int size() const {
+		return (int)workers.size() + 1;
+	}
+
+	void run(int nTasks, ThreadTask task, void* context);
+
+private:
+	void work(int worker);
+	void drain(int worker);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	unsigned long generation;
+	int active;
+	bool stopping;
+	bool pinned;
+
+	ThreadTask task;
+	void* context;
+	int nTasks;
+	std::atomic<int> next;
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+// Number of hardware threads, at least 1.
+int hardware_threads();
+
+#endif /* THREADPOOL_H_ */
@@ -0,0 +1,560 @@
+/* bench.cpp
+ Throughput benchmarks of the evaluator, run by `make bench`.
+
+ Microbenchmarks time the evaluation kernels (portfolio_problem,
+ evaluate_table, evaluate_batch, evaluate_fixed and the double and float
+ ensemble kernels) and the MOEA protocol functions (MOEA_Next_solution,
+ MOEA_Read_doubles, MOEA_Write) on in-memory streams.  Where
+ perf_event_open is permitted, the kernels also report cycles,
+ instructions, L1 data and last-level cache misses and branch misses per
+ evaluation, counted in user space as one group.  End-to-end benchmarks run
+ portfolio.exe behind pipes with a synthetic Borg-like driver, either one
+ solution at a time (as Borg's serial mode does) or a generation at a time,
+ and count the read and write system calls portfolio.exe makes per
+ evaluation.
+
+ Each result is printed as a table row and, with -o, appended to a file as
+ one JSON object per line for tracking trends.
+
+ Usage: bench.exe [-e exe] [-P programs] [-n solutions] [-p population] [-S scenarios] [-t seconds] [-o file]
+                  [-V isa]
+   -e  evaluator for the end-to-end benchmarks (default ./portfolio.exe)
+   -P  comma-separated program counts for the microbenchmarks (default 22,1000)
+   -n  distinct solutions cycled through by the microbenchmarks (default 1024)
+   -p  solutions per generation in the end-to-end benchmarks (default 100)
+   -S  scenarios per evaluate_ensemble call (default 256)
+   -t  minimum time per measurement in seconds (default 0.5)
+   -o  file the JSON results are appended to
+   -V  instruction set of the kernels, here and in the evaluator: sse2, avx2
+       or avx512 (default: the best the CPU supports)
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "ensemble.h"
+#include "fixedpoint.h"
+#include "synthetic.h"
+#include "moeaframework.h"
+#include "simd.h"
+
+using namespace std;
+
+extern FILE* MOEA_Stream_input;
+extern FILE* MOEA_Stream_output;
+
+static FILE* json = NULL;
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* hardware counters of the calling thread, opened as one group so they are
+   counted over the same instructions */
+#define N_COUNTERS 5
+
+static const char* counterNames[N_COUNTERS] = { "cycles", "instructions", "l1d_misses", "llc_misses",
+		"branch_misses" };
+static int counterFds[N_COUNTERS] = { -1, -1, -1, -1, -1 };
+static int groupFd = -1;
+static int nOpen = 0;
+
+static void open_counters() {
+	struct {
+		uint32_t type;
+		uint64_t config;
+	} events[N_COUNTERS] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+				(PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+
+	for (int e = 0; e < N_COUNTERS; e++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[e].type;
+		attr.config = events[e].config;
+		attr.disabled = (groupFd == -1);
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED |
+				PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		/* events the processor lacks are left out of the group */
+		int fd = syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+		if (fd == -1) {
+			if (e == 0) {
+				fprintf(stderr, "Hardware counters unavailable (%s); check /proc/sys/kernel/perf_event_paranoid\n",
+						strerror(errno));
+				return;
+			}
+			continue;
+		}
+
+		if (groupFd == -1) groupFd = fd;
+		counterFds[e] = fd;
+		nOpen++;
+	}
+}
+
+static void start_counters() {
+	if (groupFd == -1) return;
+	ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Counts since start_counters, scaled up if the group was multiplexed; -1 for
+// counters that are not available.
+static void stop_counters(double* values) {
+	fill_n(values, N_COUNTERS, -1.0);
+	if (groupFd == -1) return;
+	ioctl(groupFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	uint64_t data[3 + 2 * N_COUNTERS];
+	if (read(groupFd, data, sizeof(data)) <= 0 || data[2] == 0) return;
+
+	double scale = (double)data[1] / data[2];
+	for (uint64_t i = 0; i < data[0]; i++) {
+		uint64_t id;
+		for (int e = 0; e < N_COUNTERS; e++) {
+			if (counterFds[e] != -1 && ioctl(counterFds[e], PERF_EVENT_IOC_ID, &id) == 0 && id == data[4 + 2 * i])
+				values[e] = data[3 + 2 * i] * scale;
+		}
+	}
+}
+
+static void report(const char* name, int nPrograms, long evaluations, double elapsed, double syscalls,
+		const double* counts = NULL) {
+	double rate = evaluations / elapsed;
+
+	printf("%-24s %8d %14.0f %12.1f", name, nPrograms, rate, 1e9 / rate);
+	if (syscalls >= 0)
+		printf(" %13.3f", syscalls);
+	else if (counts != NULL && nOpen > 0)
+		printf(" %13s", "");
+	if (counts != NULL && nOpen > 0) {
+		for (int e = 0; e < N_COUNTERS; e++) {
+			if (counts[e] >= 0)
+				printf(" %13.2f", counts[e] / evaluations);
+			else
+				printf(" %13s", "-");
+		}
+		if (counts[0] > 0 && counts[1] >= 0)
+			printf(" %6.2f", counts[1] / counts[0]);
+	}
+	printf("\n");
+	fflush(stdout);
+
+	if (json != NULL) {
+		fprintf(json, "{\"benchmark\": \"%s\", \"programs\": %d, \"time\": %ld, \"evaluations\": %ld, "
+				"\"evals_per_sec\": %.1f, \"ns_per_eval\": %.2f, \"isa\": \"%s\"", name, nPrograms,
+				(long)time(NULL), evaluations, rate, 1e9 / rate, simd_level_name(simdLevel));
+		if (syscalls >= 0)
+			fprintf(json, ", \"syscalls_per_eval\": %.4f", syscalls);
+		for (int e = 0; counts != NULL && e < N_COUNTERS; e++)
+			if (counts[e] >= 0)
+				fprintf(json, ", \"%s_per_eval\": %.4f", counterNames[e], counts[e] / evaluations);
+		fprintf(json, "}\n");
+		fflush(json);
+	}
+}
+
+// Repeats body, which evaluates perCall solutions, until minTime has passed,
+// counting hardware events over the timed calls.
+template<class Body>
+static void measure(const char* name, int nPrograms, int perCall, double minTime, Body body) {
+	double counts[N_COUNTERS];
+	long count = 0;
+
+	body(); // warm up
+
+	start_counters();
+	double start = now(), elapsed;
+	do {
+		body();
+		count += perCall;
+		elapsed = now() - start;
+	} while (elapsed < minTime);
+	stop_counters(counts);
+
+	report(name, nPrograms, count, elapsed, -1, counts);
+}
+
+static void random_vars(const PortfolioModel& model, int nSolutions, vector<double>& vars) {
+	vars.resize((size_t)nSolutions * model.nPrograms);
+	for (int s = 0; s < nSolutions; s++)
+		for (int progIdx = 0; progIdx < model.nPrograms; progIdx++)
+			vars[(size_t)s * model.nPrograms + progIdx] = model.options(progIdx) * (rand() / (RAND_MAX + 1.0));
+}
+
+static string solution_lines(const vector<double>& vars, int nPrograms) {
+	string text;
+	char value[32];
+
+	for (size_t i = 0; i < vars.size(); i++) {
+		snprintf(value, sizeof(value), "%.17g", vars[i]);
+		text += value;
+		text += ((i + 1) % nPrograms == 0) ? '\n' : ' ';
+	}
+
+	return text;
+}
+
+// The evaluation kernels: the scalar reference, the table path, the batched
+// path on one thread, the fixed-point kernel when the model allows it and
+// the ensemble kernel, which counts one evaluation per
+// portfolio and scenario.
+static void bench_evaluation(const PortfolioModel& model, int nSolutions, int nScenarios, double minTime) {
+	Scenario scenario;
+	ScenarioTable table;
+	vector<double> vars;
+	const int n = model.nPrograms;
+
+	default_scenario(model, scenario);
+	build_scenario_table(model, scenario, table);
+	random_vars(model, nSolutions, vars);
+
+	vector<uint8_t> opts((size_t)nSolutions * n);
+	vector<int> intOpts(opts.size());
+	for (int s = 0; s < nSolutions; s++)
+		decode_options(table, &vars[(size_t)s * n], &opts[(size_t)s * n]);
+	copy(opts.begin(), opts.end(), intOpts.begin());
+
+	vector<double> objs((size_t)nSolutions * nColumns), consts((size_t)nSolutions * table.constraints());
+
+	measure("portfolio_problem", n, nSolutions, minTime, [&]() {
+		for (int s = 0; s < nSolutions; s++)
+			portfolio_problem(model, scenario, &vars[(size_t)s * n], &objs[0], &consts[0]);
+	});
+
+	measure("evaluate_table", n, nSolutions, minTime, [&]() {
+		for (int s = 0; s < nSolutions; s++)
+			evaluate_table(table, &vars[(size_t)s * n], &objs[0], &consts[0]);
+	});
+
+	measure("evaluate_batch", n, nSolutions, minTime, [&]() {
+		evaluate_batch(table, &opts[0], nSolutions, &objs[0], &consts[0], NULL);
+	});
+
+	FixedTable fixed;
+	const char* why;
+	if (build_fixed_table(model, scenario, fixed, &why)) {
+		measure("evaluate_fixed", n, nSolutions, minTime, [&]() {
+			evaluate_fixed(fixed, &opts[0], nSolutions, &objs[0], &consts[0], NULL);
+		});
+	}
+
+	/* scenarios with multipliers and scales within 20% of nominal */
+	vector<double> inputs((size_t)SCENARIO_INPUTS(n) * nScenarios);
+	vector<double> outputs((size_t)ENSEMBLE_OUTPUTS * nScenarios);
+	for (size_t i = 0; i < inputs.size(); i++)
+		inputs[i] = 0.8 + 0.4 * (rand() / (RAND_MAX + 1.0));
+
+	int next = 0;
+	measure("evaluate_ensemble", n, nScenarios, minTime, [&]() {
+		evaluate_ensemble(model, &intOpts[(size_t)next * n], &inputs[0], nScenarios, &outputs[0]);
+		next = (next + 1) % nSolutions;
+	});
+
+	FloatEnsemble floats;
+	init_float_ensemble(floats, model, &inputs[0], nScenarios);
+	measure("evaluate_ensemble_float", n, nScenarios, minTime, [&]() {
+		evaluate_ensemble_float(floats, model, &intOpts[(size_t)next * n], &inputs[0], &outputs[0]);
+		next = (next + 1) % nSolutions;
+	});
+}
+
+// Reads every solution in the input stream through the MOEA functions,
+// parsing the variables too if parse is set; returns the time taken.
+static double read_pass(int nPrograms, int nSolutions, bool parse, vector<double>& vars) {
+	rewind(MOEA_Stream_input);
+
+	double start = now();
+	for (int s = 0; s < nSolutions; s++) {
+		MOEA_Next_solution();
+		if (parse) MOEA_Read_doubles(nPrograms, &vars[0]);
+	}
+	return now() - start;
+}
+
+static void bench_protocol(const PortfolioModel& model, int nSolutions, double minTime) {
+	const int n = model.nPrograms;
+	vector<double> vars;
+	random_vars(model, nSolutions, vars);
+	string text = solution_lines(vars, n);
+
+	/* solutions are read from a temporary file, which like a pipe is read
+	   through the stdio buffer */
+	MOEA_Init(nColumns, 1);
+	MOEA_Stream_input = tmpfile();
+	fwrite(text.data(), 1, text.size(), MOEA_Stream_input);
+
+	long count = 0;
+	double lineTime = 0, parseTime = 0, start = now();
+	do {
+		lineTime += read_pass(n, nSolutions, false, vars);
+		parseTime += read_pass(n, nSolutions, true, vars);
+		count += nSolutions;
+	} while (now() - start < 2 * minTime);
+	report("MOEA_Next_solution", n, count, lineTime, -1);
+	report("MOEA_Read_doubles", n, count, parseTime - lineTime, -1);
+
+	/* results go to /dev/null, flushed per result and per batch */
+	double objs[nColumns] = { 30280.387999999999, 669.25, 934.125 }, consts[1] = { 0.061016411685838504 };
+	MOEA_Stream_output = fopen("/dev/null", "w");
+
+	count = 0;
+	start = now();
+	double elapsed;
+	do {
+		for (int s = 0; s < nSolutions; s++)
+			MOEA_Write(objs, consts);
+		count += nSolutions;
+		elapsed = now() - start;
+	} while (elapsed < minTime);
+	report("MOEA_Write", n, count, elapsed, -1);
+
+	count = 0;
+	start = now();
+	do {
+		for (int s = 0; s < nSolutions; s++)
+			MOEA_Write_buffered(objs, consts);
+		MOEA_Flush();
+		count += nSolutions;
+		elapsed = now() - start;
+	} while (elapsed < minTime);
+	report("MOEA_Write_buffered", n, count, elapsed, -1);
+
+	fclose(MOEA_Stream_input);
+	fclose(MOEA_Stream_output);
+	MOEA_Init(nColumns, 1);
+}
+
+// Read and write system calls made so far by a process, from /proc/pid/io.
+static long process_syscalls(pid_t pid) {
+	char path[64], key[32];
+	long value, total = 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+	FILE* io = fopen(path, "r");
+	if (io == NULL) return -1;
+
+	while (fscanf(io, "%31s %ld", key, &value) == 2)
+		if (strcmp(key, "syscr:") == 0 || strcmp(key, "syscw:") == 0)
+			total += value;
+
+	fclose(io);
+	return total;
+}
+
+// Runs the evaluator (with the space-separated flags) behind pipes, sending generations of population
+// solutions (population 1 is one at a time) and waiting for each
+// generation's results before sending the next.
+static void bench_pipe(const char* name, const char* exe, const char* flags, const string& text,
+		int nPrograms, int nSolutions, int population, double minTime) {
+	int toChild[2], fromChild[2];
+	if (pipe(toChild) != 0 || pipe(fromChild) != 0) {
+		perror("pipe");
+		exit(EXIT_FAILURE);
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		dup2(toChild[0], STDIN_FILENO);
+		dup2(fromChild[1], STDOUT_FILENO);
+		close(toChild[0]);
+		close(toChild[1]);
+		close(fromChild[0]);
+		close(fromChild[1]);
+		vector<char*> args(1, (char*)exe);
+		for (char* p = strtok(strdup(flags), " "); p != NULL; p = strtok(NULL, " "))
+			args.push_back(p);
+		args.push_back(NULL);
+
+		execv(exe, &args[0]);
+		fprintf(stderr, "Unable to run %s\n", exe);
+		_exit(EXIT_FAILURE);
+	}
+
+	close(toChild[0]);
+	close(fromChild[1]);
+
+	/* offsets of each solution's line in text */
+	vector<size_t> lineStart(1, 0);
+	for (size_t i = 0; i < text.size(); i++)
+		if (text[i] == '\n') lineStart.push_back(i + 1);
+
+	char buffer[65536];
+	long count = 0, syscallsBefore = -1;
+	int next = 0;
+	double start = 0, elapsed = 0;
+
+	for (int generation = 0; ; generation++) {
+		/* the first generation warms up the evaluator and is not timed */
+		if (generation == 1) {
+			syscallsBefore = process_syscalls(pid);
+			start = now();
+		} else if (generation > 1 && (elapsed = now() - start) >= minTime) {
+			break;
+		}
+
+		int nSend = min(population, nSolutions - next);
+		size_t from = lineStart[next], to = lineStart[next + nSend];
+		next = (next + nSend) % nSolutions;
+
+		/* interleave writing and reading so neither pipe can fill up */
+		int pending = nSend;
+		struct pollfd fds[2] = { { toChild[1], POLLOUT, 0 }, { fromChild[0], POLLIN, 0 } };
+
+		while (pending > 0) {
+			fds[0].fd = (from < to) ? toChild[1] : -1;
+			if (poll(fds, 2, -1) < 0) continue;
+
+			if (fds[0].revents & POLLOUT) {
+				ssize_t written = write(toChild[1], text.data() + from, min(to - from, (size_t)4096));
+				if (written > 0) from += written;
+			}
+
+			if (fds[1].revents & (POLLIN | POLLHUP)) {
+				ssize_t got = read(fromChild[0], buffer, sizeof(buffer));
+				if (got <= 0) {
+					fprintf(stderr, "%s exited early\n", exe);
+					exit(EXIT_FAILURE);
+				}
+				for (char* p = buffer; (p = (char*)memchr(p, '\n', buffer + got - p)) != NULL; p++)
+					pending--;
+			}
+		}
+
+		if (generation >= 1) count += nSend;
+	}
+
+	long syscalls = process_syscalls(pid) - syscallsBefore;
+	close(toChild[1]);
+	close(fromChild[0]);
+	waitpid(pid, NULL, 0);
+
+	report(name, nPrograms, count, elapsed, syscallsBefore >= 0 ? (double)syscalls / count : -1);
+}
+
+int main(int argc, char* argv[]) {
+	const char* exe = "./portfolio.exe";
+	const char* output = NULL;
+	vector<int> counts;
+	int nSolutions = 1024;
+	int population = 100;
+	int nScenarios = 256;
+	double minTime = 0.5;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "e:P:n:p:S:t:o:V:")) != -1) {
+		switch (opt) {
+		case 'e':
+			exe = optarg;
+			break;
+		case 'P':
+			for (char* p = strtok(optarg, ","); p != NULL; p = strtok(NULL, ","))
+				counts.push_back(atoi(p));
+			break;
+		case 'n':
+			nSolutions = atoi(optarg);
+			break;
+		case 'p':
+			population = atoi(optarg);
+			break;
+		case 'S':
+			nScenarios = atoi(optarg);
+			break;
+		case 't':
+			minTime = atof(optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'V':
+			if (!set_simd_level(optarg)) {
+				fprintf(stderr, "Instruction set %s is unknown or not supported here\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-e exe] [-P programs] [-n solutions] [-p population] [-S scenarios] [-t seconds] [-o file] [-V isa]\n",
+					argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (counts.empty()) {
+		counts.push_back(22);
+		counts.push_back(1000);
+	}
+
+	if (nSolutions < population) {
+		fprintf(stderr, "Need at least as many solutions (%d) as the population (%d)\n", nSolutions, population);
+		exit(EXIT_FAILURE);
+	}
+
+	if (output != NULL && (json = fopen(output, "a")) == NULL) {
+		fprintf(stderr, "Unable to open %s\n", output);
+		exit(EXIT_FAILURE);
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	srand(1);
+	open_counters();
+	printf("kernels at %s\n", simd_level_name(simdLevel));
+	printf("%-24s %8s %14s %12s %13s", "benchmark", "programs", "evals/s", "ns/eval", "syscalls/eval");
+	if (nOpen > 0)
+		printf(" %13s %13s %13s %13s %13s %6s", "cycles/eval", "instr/eval", "L1d-miss/eval", "LLC-miss/eval",
+				"br-miss/eval", "IPC");
+	printf("\n");
+
+	/* a count of 22 is the built-in model, others are synthetic */
+	for (size_t i = 0; i < counts.size(); i++) {
+		PortfolioModel model;
+		if (counts[i] == 22)
+			builtin_model(model);
+		else
+			synthetic_model(model, counts[i], 2, 9, 0.5, 1);
+
+		bench_evaluation(model, nSolutions, nScenarios, minTime);
+		bench_protocol(model, nSolutions, minTime);
+	}
+
+	/* end to end against the evaluator's built-in model */
+	PortfolioModel model;
+	vector<double> vars;
+	builtin_model(model);
+	random_vars(model, nSolutions, vars);
+	string text = solution_lines(vars, model.nPrograms);
+	char flags[32], batchFlags[48];
+	snprintf(flags, sizeof(flags), "-V %s", simd_level_name(simdLevel));
+	snprintf(batchFlags, sizeof(batchFlags), "%s -B %d", flags, population);
+
+	bench_pipe("pipe-serial", exe, flags, text, model.nPrograms, nSolutions, 1, minTime);
+	bench_pipe("pipe-generation", exe, flags, text, model.nPrograms, nSolutions, population, minTime);
+	bench_pipe("pipe-generation-batch", exe, batchFlags, text, model.nPrograms, nSolutions, population, minTime);
+
+	if (json != NULL) fclose(json);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/* bounds.cpp
+ Ideal and nadir points of the three objectives, for the nominal scenario or
+ over a scenario ensemble, with the epsilons and hypervolume reference point
+ they imply.  The output is meant for configuring Borg runs and the
+ normalization of their results.
+
+ Usage: bounds.exe [-M model] [-X scenarios] [-d divisions] [-v]
+   -M  model file (defaults to the table in modeldfn.h)
+   -X  scenario file as for prim.exe (default: the nominal scenario)
+   -d  epsilon is (nadir - ideal) / divisions (default 100)
+   -v  also print the ideal and nadir point of every scenario
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "ensemble.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	const char* modelFile = NULL;
+	const char* scenarioFile = NULL;
+	double divisions = 100;
+	bool verbose = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "M:X:d:v")) != -1) {
+		switch (opt) {
+		case 'M':
+			modelFile = optarg;
+			break;
+		case 'X':
+			scenarioFile = optarg;
+			break;
+		case 'd':
+			divisions = atof(optarg);
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-M model] [-X scenarios] [-d divisions] [-v]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	PortfolioModel model;
+	if (modelFile != NULL)
+		load_model(modelFile, model);
+	else
+		builtin_model(model);
+
+	vector<double> inputs;
+	int nScenarios = 1;
+	if (scenarioFile != NULL)
+		load_scenarios(scenarioFile, model, inputs, nScenarios);
+	else
+		inputs.assign(SCENARIO_INPUTS(model.nPrograms), 1.0);
+
+	if (nScenarios == 0) {
+		fprintf(stderr, "No scenarios in %s\n", scenarioFile);
+		exit(EXIT_FAILURE);
+	}
+
+	vector<double> ideal((size_t)nColumns * nScenarios), nadir(ideal.size());
+	ensemble_bounds(model, &inputs[0], nScenarios, &ideal[0], &nadir[0]);
+
+	if (verbose) {
+		for (int s = 0; s < nScenarios; s++) {
+			for (int c = 0; c < nColumns; c++)
+				printf("%.17g ", ideal[c * nScenarios + s]);
+			for (int c = 0; c < nColumns; c++)
+				printf(c < nColumns - 1 ? "%.17g " : "%.17g\n", nadir[c * nScenarios + s]);
+		}
+		printf("\n");
+	}
+
+	const char* names[nColumns] = { "bau", "ss", "cost" };
+	printf("%-6s %16s %16s %16s %16s\n", "", "ideal", "nadir", "epsilon", "reference");
+
+	for (int c = 0; c < nColumns; c++) {
+		double lo = *min_element(&ideal[c * nScenarios], &ideal[(c + 1) * nScenarios]);
+		double hi = *max_element(&nadir[c * nScenarios], &nadir[(c + 1) * nScenarios]);
+		double epsilon = (hi - lo) / divisions;
+
+		printf("%-6s %16.6f %16.6f %16.6f %16.6f\n", names[c], lo, hi, epsilon, hi + epsilon);
+	}
+
+	return EXIT_SUCCESS;
+}
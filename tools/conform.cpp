@@ -0,0 +1,586 @@
+/* conform.cpp
+ Differential conformance test of the evaluation paths against the scalar
+ reference, portfolio_problem.
+
+ The corpus crosses decision vectors with scenarios.  Half the vectors are
+ uniformly random; the rest are adversarial, each variable drawn from 0,
+ -0, an exact option boundary k, the largest value below it, k + 0.5, the
+ largest value below the upper bound and values outside the bounds, which
+ option_index clamps.  Scenarios are the nominal one, random multipliers
+ and scales within 50% of nominal, and scenarios whose budget scale puts the
+ budget exactly on, one ulp above and one ulp below the cost of a solution
+ in the corpus.
+
+ Every path evaluates the whole corpus; results are compared with the
+ reference in ulps of the larger of the two values and the magnitude of the
+ quantity (the budget for constraints).  Paths that promise the reference's
+ results (table, options, packed, batch, batch-mt, ensemble) must match
+ exactly.  The incremental sums of the enumeration (delta) path reassociate
+ the additions, so it is allowed -u ulps (default: the number of programs).
+ The fixed-point path (fixed) sums exactly and rounds only in the
+ conversion, so it is allowed as many ulps as the reference's own rounding
+ and must agree on feasibility; it covers only the scenarios it can
+ evaluate exactly.  The float ensemble kernel (ens-float) must stay within
+ its error bound and agree on feasibility, and regret computed with it
+ (reg-float) must match regret from the double kernel exactly.  The
+ screened path must match exactly except for the bau and ss of infeasible
+ solutions, which must be the scenario's nadir and no better than the
+ reference's.  Monte
+ Carlo evaluation has no scalar reference and is not covered.
+
+ Usage: conform.exe [-M model] [-n solutions] [-s scenarios] [-J threads] [-u ulps] [-S seed] [-V isa]
+   -M  model file (defaults to the table in modeldfn.h)
+   -n  decision vectors (default 2000)
+   -s  scenarios including the nominal and budget-boundary ones (default 16)
+   -J  threads for the batch-mt path (default: hardware threads)
+   -u  tolerance of the delta and fixed paths in ulps (default: programs)
+   -S  random seed (default 1)
+   -V  instruction set of the kernels (default: the best the CPU supports)
+
+ Exits with status 1 if any path fails.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "batch.h"
+#include "ensemble.h"
+#include "enumerate.h"
+#include "fixedpoint.h"
+#include "genome.h"
+#include "regret.h"
+#include "simd.h"
+
+using namespace std;
+
+#define DELTA_SOLUTIONS 16 // solutions per scenario whose neighbourhoods the delta path enumerates
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct Corpus {
+	const PortfolioModel* model;
+	int nSolutions;
+	int nScenarios;
+	int nConsts;
+	vector<double> vars;
+	vector<uint8_t> opts;
+	vector<int> intOpts;
+	vector<uint64_t> genomes;
+	GenomeLayout layout;
+	vector<double> inputs;            // input-major, as ensemble.h
+	vector<Scenario> scenarios;
+	vector<ScenarioTable> tables;
+	vector<double> refObjs;           // [(scenario * nSolutions + s) * nColumns + c]
+	vector<double> refConsts;         // [(scenario * nSolutions + s) * nConsts + c]
+};
+
+struct PathResult {
+	long evaluations;
+	double seconds;
+	double maxUlps;
+	long failures;
+};
+
+// Distance between a value and the reference in ulps of the larger of the
+// two and magnitude.
+static double ulps(double value, double reference, double magnitude) {
+	if (value == reference) return 0;
+	if (isnan(value) || isnan(reference)) return INFINITY;
+
+	double scale = max(max(fabs(value), fabs(reference)), fabs(magnitude));
+	return fabs(value - reference) / (nextafter(scale, INFINITY) - scale);
+}
+
+static void build_corpus(Corpus& c, const PortfolioModel& model, int nSolutions, int nScenarios, mt19937& rng) {
+	const int n = model.nPrograms;
+	uniform_real_distribution<double> uniform(0.0, 1.0);
+
+	c.model = &model;
+	c.nSolutions = nSolutions;
+	c.nScenarios = nScenarios;
+	c.vars.resize((size_t)nSolutions * n);
+
+	for (int s = 0; s < nSolutions; s++) {
+		for (int progIdx = 0; progIdx < n; progIdx++) {
+			double options = model.options(progIdx);
+			double k = (int)(options * uniform(rng));
+			double& v = c.vars[(size_t)s * n + progIdx];
+
+			if (s < nSolutions / 2) {
+				v = options * uniform(rng);
+				continue;
+			}
+
+			switch (rng() % 8) {
+			case 0: v = 0.0; break;
+			case 1: v = -0.0; break;
+			case 2: v = k; break;
+			case 3: v = nextafter(k, 0.0); break;
+			case 4: v = k + 0.5; break;
+			case 5: v = nextafter(options, 0.0); break;
+			case 6: v = -1.5; break;
+			default: v = options + 2.0; break;
+			}
+		}
+	}
+
+	/* option indices, as the batched paths take them */
+	Scenario nominal;
+	ScenarioTable nominalTable;
+	default_scenario(model, nominal);
+	build_scenario_table(model, nominal, nominalTable);
+	c.nConsts = nominalTable.constraints();
+
+	build_genome_layout(model, c.layout);
+	c.opts.resize(c.vars.size());
+	c.intOpts.resize(c.vars.size());
+	c.genomes.resize((size_t)nSolutions * c.layout.nWords);
+	for (int s = 0; s < nSolutions; s++) {
+		decode_options(nominalTable, &c.vars[(size_t)s * n], &c.opts[(size_t)s * n]);
+		copy(&c.opts[(size_t)s * n], &c.opts[(size_t)(s + 1) * n], &c.intOpts[(size_t)s * n]);
+		pack_genome(c.layout, &c.intOpts[(size_t)s * n], &c.genomes[(size_t)s * c.layout.nWords]);
+	}
+
+	/* scenarios: nominal, three around the cost of one solution, then random */
+	c.inputs.assign((size_t)SCENARIO_INPUTS(n) * nScenarios, 1.0);
+	for (int sc = 4; sc < nScenarios; sc++)
+		for (int i = 0; i < SCENARIO_INPUTS(n); i++)
+			c.inputs[(size_t)i * nScenarios + sc] = 0.5 + uniform(rng);
+
+	double cost = 0;
+	int target = rng() % nSolutions;
+	for (int progIdx = 0; progIdx < n; progIdx++)
+		cost += model.row(progIdx, c.opts[(size_t)target * n + progIdx])[COL_COST];
+
+	double onBudget = cost / model.costThreshold;
+	for (int sc = 1; sc < 4 && sc < nScenarios; sc++) {
+		double scale = onBudget;
+		if (sc == 2) scale = nextafter(onBudget, INFINITY);
+		if (sc == 3) scale = nextafter(onBudget, 0.0);
+		c.inputs[(size_t)INPUT_BUDGET_SCALE(n) * nScenarios + sc] = scale;
+	}
+
+	c.scenarios.resize(nScenarios);
+	c.tables.resize(nScenarios);
+	c.refObjs.resize((size_t)nScenarios * nSolutions * nColumns);
+	c.refConsts.resize((size_t)nScenarios * nSolutions * c.nConsts);
+
+	for (int sc = 0; sc < nScenarios; sc++) {
+		scenario_from_inputs(model, &c.inputs[0], nScenarios, sc, c.scenarios[sc]);
+		build_scenario_table(model, c.scenarios[sc], c.tables[sc]);
+
+		for (int s = 0; s < nSolutions; s++) {
+			size_t i = (size_t)sc * nSolutions + s;
+			portfolio_problem(model, c.scenarios[sc], &c.vars[(size_t)s * n], &c.refObjs[i * nColumns],
+					&c.refConsts[i * c.nConsts]);
+		}
+	}
+}
+
+// Compares the results of evaluation i (scenario-major) with the reference,
+// updating the path's worst distance and failure count.
+static void check(const Corpus& c, int scenario, size_t i, const double* objs, const double* consts, int nConsts,
+		double tolerance, PathResult& result) {
+	const ScenarioTable& table = c.tables[scenario];
+	double worst = 0;
+
+	for (int col = 0; col < nColumns; col++)
+		worst = max(worst, ulps(objs[col], c.refObjs[i * nColumns + col], 0));
+	for (int k = 0; k < nConsts; k++)
+		worst = max(worst, ulps(consts[k], c.refConsts[i * c.nConsts + k], k == 0 ? table.budget : table.yearBudget[k - 1]));
+
+	result.maxUlps = max(result.maxUlps, worst);
+	if (worst > tolerance) result.failures++;
+}
+
+// Runs one of the exact paths over every scenario and checks it.
+static PathResult run_path(const Corpus& c, int path, ThreadPool* pool) {
+	const int n = c.model->nPrograms, nSol = c.nSolutions;
+	vector<double> objs((size_t)nSol * nColumns), consts((size_t)nSol * c.nConsts);
+	PathResult result = { 0, 0, 0, 0 };
+
+	for (int sc = 0; sc < c.nScenarios; sc++) {
+		const ScenarioTable& table = c.tables[sc];
+		double start = now();
+
+		switch (path) {
+		case 0:
+			for (int s = 0; s < nSol; s++)
+				evaluate_table(table, &c.vars[(size_t)s * n], &objs[s * nColumns], &consts[s * c.nConsts]);
+			break;
+		case 1:
+			for (int s = 0; s < nSol; s++)
+				evaluate_options(table, &c.intOpts[(size_t)s * n], &objs[s * nColumns], &consts[s * c.nConsts]);
+			break;
+		case 2:
+			for (int s = 0; s < nSol; s++)
+				evaluate_packed(table, c.layout, &c.genomes[(size_t)s * c.layout.nWords], &objs[s * nColumns],
+						&consts[s * c.nConsts]);
+			break;
+		case 3:
+			evaluate_batch(table, &c.opts[0], nSol, &objs[0], &consts[0], NULL);
+			break;
+		case 4:
+			evaluate_batch(table, &c.opts[0], nSol, &objs[0], &consts[0], pool);
+			break;
+		}
+
+		result.seconds += now() - start;
+		result.evaluations += nSol;
+
+		for (int s = 0; s < nSol; s++)
+			check(c, sc, (size_t)sc * nSol + s, &objs[s * nColumns], &consts[s * c.nConsts], c.nConsts, 0, result);
+	}
+
+	return result;
+}
+
+// The ensemble kernel evaluates one portfolio over all scenarios; it gives
+// the objectives and the total budget constraint.
+static PathResult run_ensemble(const Corpus& c) {
+	const int n = c.model->nPrograms, nSc = c.nScenarios;
+	vector<double> outputs((size_t)ENSEMBLE_OUTPUTS * nSc);
+	PathResult result = { 0, 0, 0, 0 };
+
+	for (int s = 0; s < c.nSolutions; s++) {
+		double start = now();
+		evaluate_ensemble(*c.model, &c.intOpts[(size_t)s * n], &c.inputs[0], nSc, &outputs[0]);
+		result.seconds += now() - start;
+		result.evaluations += nSc;
+
+		for (int sc = 0; sc < nSc; sc++) {
+			double objs[nColumns], consts[1];
+			for (int col = 0; col < nColumns; col++)
+				objs[col] = outputs[(size_t)col * nSc + sc];
+			consts[0] = outputs[(size_t)nColumns * nSc + sc];
+			check(c, sc, (size_t)sc * c.nSolutions + s, objs, consts, 1, 0, result);
+		}
+	}
+
+	return result;
+}
+
+// The float ensemble kernel must stay within its error bound, taken here in
+// ulps of the sum it bounds, and agree on feasibility.
+static PathResult run_ensemble_float(const Corpus& c, double& tolerance) {
+	const int n = c.model->nPrograms, nSc = c.nScenarios;
+	const double gamma = (n + 4) * (double)FLT_EPSILON;
+	vector<double> outputs((size_t)ENSEMBLE_OUTPUTS * nSc);
+	PathResult result = { 0, 0, 0, 0 };
+	FloatEnsemble floats;
+
+	init_float_ensemble(floats, *c.model, &c.inputs[0], nSc);
+	tolerance = gamma / DBL_EPSILON;
+
+	for (int s = 0; s < c.nSolutions; s++) {
+		double start = now();
+		evaluate_ensemble_float(floats, *c.model, &c.intOpts[(size_t)s * n], &c.inputs[0], &outputs[0]);
+		result.seconds += now() - start;
+		result.evaluations += nSc;
+
+		for (int sc = 0; sc < nSc; sc++) {
+			size_t i = (size_t)sc * c.nSolutions + s;
+			double worst = 0;
+
+			for (int col = 0; col < nColumns; col++) {
+				double scale = fabs(c.inputs[(size_t)(INPUT_BAU_SCALE(n) + col) * nSc + sc]);
+				double sum = floats.error[(size_t)col * nSc + sc] / gamma * scale;
+				worst = max(worst, ulps(outputs[(size_t)col * nSc + sc], c.refObjs[i * nColumns + col], sum));
+			}
+
+			double violation = outputs[(size_t)nColumns * nSc + sc], reference = c.refConsts[i * c.nConsts];
+			double sum = max(floats.error[(size_t)COL_COST * nSc + sc] / gamma, floats.budget[sc]);
+			worst = max(worst, ulps(violation, reference, sum));
+
+			result.maxUlps = max(result.maxUlps, worst);
+			if (worst > tolerance || (violation > 0) != (reference > 0)) result.failures++;
+		}
+	}
+
+	return result;
+}
+
+// Regret from the float kernel, rechecked near the order statistic, must be
+// exactly that of the double kernel, for the maximum and the median.
+static PathResult run_regret_float(const Corpus& c) {
+	const int nSol = c.nSolutions;
+	vector<double> objs((size_t)nSol * nColumns), single((size_t)nSol * nColumns);
+	PathResult result = { 0, 0, 0, 0 };
+	const double quantiles[] = { 1.0, 0.5 };
+
+	for (int q = 0; q < 2; q++) {
+		RegretEnsemble reference, floats;
+		init_regret(reference, *c.model, c.inputs, c.nScenarios, quantiles[q], false);
+		init_regret(floats, *c.model, c.inputs, c.nScenarios, quantiles[q], true);
+		regret_objectives(reference, *c.model, &c.opts[0], nSol, &objs[0], NULL);
+
+		double start = now();
+		regret_objectives(floats, *c.model, &c.opts[0], nSol, &single[0], NULL);
+		result.seconds += now() - start;
+		result.evaluations += (long)nSol * c.nScenarios;
+
+		for (int s = 0; s < nSol; s++) {
+			double worst = 0;
+			for (int col = 0; col < nColumns; col++)
+				worst = max(worst, ulps(single[s * nColumns + col], objs[s * nColumns + col], 0));
+
+			result.maxUlps = max(result.maxUlps, worst);
+			if (worst > 0) result.failures++;
+		}
+	}
+
+	return result;
+}
+
+// Everything must match exactly except the bau and ss of infeasible
+// solutions, which must be the nadir, no better than the reference values.
+static PathResult run_screened(const Corpus& c, ThreadPool* pool) {
+	const int nSol = c.nSolutions;
+	vector<double> objs((size_t)nSol * nColumns), consts((size_t)nSol * c.nConsts);
+	PathResult result = { 0, 0, 0, 0 };
+
+	for (int sc = 0; sc < c.nScenarios; sc++) {
+		const ScenarioTable& table = c.tables[sc];
+		double start = now();
+		evaluate_batch_screened(table, &c.opts[0], nSol, &objs[0], &consts[0], pool);
+		result.seconds += now() - start;
+		result.evaluations += nSol;
+
+		for (int s = 0; s < nSol; s++) {
+			size_t i = (size_t)sc * nSol + s;
+			double* screened = &objs[s * nColumns];
+
+			if (c.refConsts[i * c.nConsts] > 0) {
+				const double* reference = &c.refObjs[i * nColumns];
+				if (screened[COL_BAU] != table.nadir[COL_BAU] || screened[COL_SS] != table.nadir[COL_SS]
+						|| !(reference[COL_BAU] <= table.nadir[COL_BAU]) || !(reference[COL_SS] <= table.nadir[COL_SS]))
+					result.failures++;
+
+				/* the rest is compared as usual */
+				screened[COL_BAU] = reference[COL_BAU];
+				screened[COL_SS] = reference[COL_SS];
+			}
+
+			check(c, sc, i, screened, &consts[s * c.nConsts], c.nConsts, 0, result);
+		}
+	}
+
+	return result;
+}
+
+struct DeltaContext {
+	const Corpus* c;
+	int scenario;
+	double tolerance;
+	PathResult* result;
+	vector<double> vars;
+	vector<double> refObjs;
+	vector<double> refConsts;
+};
+
+static bool check_delta(const int* opts, const double* objs, const double* consts, void* context) {
+	DeltaContext& d = *(DeltaContext*)context;
+	const Corpus& c = *d.c;
+	const int n = c.model->nPrograms;
+	const ScenarioTable& table = c.tables[d.scenario];
+
+	for (int progIdx = 0; progIdx < n; progIdx++)
+		d.vars[progIdx] = opts[progIdx] + 0.5;
+	portfolio_problem(*c.model, c.scenarios[d.scenario], &d.vars[0], &d.refObjs[0], &d.refConsts[0]);
+
+	double worst = 0;
+	for (int col = 0; col < nColumns; col++)
+		worst = max(worst, ulps(objs[col], d.refObjs[col], 0));
+	for (int k = 0; k < c.nConsts; k++)
+		worst = max(worst, ulps(consts[k], d.refConsts[k], k == 0 ? table.budget : table.yearBudget[k - 1]));
+
+	d.result->maxUlps = max(d.result->maxUlps, worst);
+	if (worst > d.tolerance) d.result->failures++;
+	d.result->evaluations++;
+	return true;
+}
+
+// Runs the fixed-point kernel over the scenarios it accepts; with the
+// built-in model those are the nominal and budget-boundary ones.
+static PathResult run_fixed(const Corpus& c, double tolerance, ThreadPool* pool) {
+	const int nSol = c.nSolutions;
+	vector<double> objs((size_t)nSol * nColumns), consts(nSol);
+	PathResult result = { 0, 0, 0, 0 };
+
+	for (int sc = 0; sc < c.nScenarios; sc++) {
+		FixedTable table;
+		const char* why;
+		if (!build_fixed_table(*c.model, c.scenarios[sc], table, &why)) continue;
+
+		double start = now();
+		evaluate_fixed(table, &c.opts[0], nSol, &objs[0], &consts[0], pool);
+		result.seconds += now() - start;
+		result.evaluations += nSol;
+
+		for (int s = 0; s < nSol; s++) {
+			size_t i = (size_t)sc * nSol + s;
+			if ((consts[s] > 0) != (c.refConsts[i * c.nConsts] > 0))
+				result.failures++;
+			check(c, sc, i, &objs[s * nColumns], &consts[s], 1, tolerance, result);
+		}
+	}
+
+	return result;
+}
+
+// Enumerates two programs around some solutions of each scenario; the
+// reference evaluation inside the callback is included in the time.
+static PathResult run_delta(const Corpus& c, double tolerance, mt19937& rng) {
+	const int n = c.model->nPrograms;
+	PathResult result = { 0, 0, 0, 0 };
+	DeltaContext d;
+	d.c = &c;
+	d.tolerance = tolerance;
+	d.result = &result;
+	d.vars.resize(n);
+	d.refObjs.resize(nColumns);
+	d.refConsts.resize(c.nConsts);
+
+	if (n < 2) return result;
+
+	for (int sc = 0; sc < c.nScenarios; sc++) {
+		d.scenario = sc;
+		for (int k = 0; k < DELTA_SOLUTIONS && k < c.nSolutions; k++) {
+			int s = rng() % c.nSolutions;
+			int freePrograms[2] = { (int)(rng() % n), 0 };
+			do {
+				freePrograms[1] = rng() % n;
+			} while (freePrograms[1] == freePrograms[0]);
+
+			double start = now();
+			enumerate_portfolios(c.tables[sc], &c.intOpts[(size_t)s * n], freePrograms, 2, check_delta, &d);
+			result.seconds += now() - start;
+		}
+	}
+
+	return result;
+}
+
+static void print_result(const char* name, double tolerance, const PathResult& r) {
+	printf("%-10s %10ld %14.0f %10.0f %10.1f %10ld  %s\n", name, r.evaluations,
+			r.seconds > 0 ? r.evaluations / r.seconds : 0, tolerance, r.maxUlps, r.failures,
+			r.failures > 0 ? "FAIL" : "ok");
+}
+
+int main(int argc, char* argv[]) {
+	const char* modelFile = NULL;
+	int nSolutions = 2000;
+	int nScenarios = 16;
+	int nThreads = hardware_threads();
+	double deltaUlps = -1;
+	unsigned int seed = 1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "M:n:s:J:u:S:V:")) != -1) {
+		switch (opt) {
+		case 'M':
+			modelFile = optarg;
+			break;
+		case 'n':
+			nSolutions = max(1, atoi(optarg));
+			break;
+		case 's':
+			nScenarios = max(1, atoi(optarg));
+			break;
+		case 'J':
+			nThreads = max(1, atoi(optarg));
+			break;
+		case 'u':
+			deltaUlps = atof(optarg);
+			break;
+		case 'S':
+			seed = atoi(optarg);
+			break;
+		case 'V':
+			if (!set_simd_level(optarg)) {
+				fprintf(stderr, "Instruction set %s is unknown or not supported here\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-M model] [-n solutions] [-s scenarios] [-J threads] [-u ulps] [-S seed] "
+					"[-V isa]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	PortfolioModel model;
+	if (modelFile != NULL)
+		load_model(modelFile, model);
+	else
+		builtin_model(model);
+
+	if (deltaUlps < 0) deltaUlps = model.nPrograms;
+
+	mt19937 rng(seed);
+	Corpus c;
+	build_corpus(c, model, nSolutions, nScenarios, rng);
+	ThreadPool pool(nThreads);
+
+	/* the reference's own throughput, for comparison */
+	PathResult reference = { 0, 0, 0, 0 };
+	vector<double> objs(nColumns), consts(c.nConsts);
+	for (int sc = 0; sc < nScenarios; sc++) {
+		double start = now();
+		for (int s = 0; s < nSolutions; s++)
+			portfolio_problem(model, c.scenarios[sc], &c.vars[(size_t)s * model.nPrograms], &objs[0], &consts[0]);
+		reference.seconds += now() - start;
+		reference.evaluations += nSolutions;
+	}
+
+	printf("%d programs, %d solutions x %d scenarios, kernels at %s\n", model.nPrograms, nSolutions, nScenarios,
+			simd_level_name(simdLevel));
+	printf("%-10s %10s %14s %10s %10s %10s\n", "path", "evals", "evals/s", "tolerance", "max-ulps", "failures");
+	print_result("reference", 0, reference);
+
+	const char* names[] = { "table", "options", "packed", "batch", "batch-mt" };
+	long failures = 0;
+	for (int path = 0; path < 5; path++) {
+		PathResult r = run_path(c, path, &pool);
+		print_result(names[path], 0, r);
+		failures += r.failures;
+	}
+
+	PathResult r = run_screened(c, &pool);
+	print_result("screened", 0, r);
+	failures += r.failures;
+
+	r = run_ensemble(c);
+	print_result("ensemble", 0, r);
+	failures += r.failures;
+
+	double floatUlps;
+	r = run_ensemble_float(c, floatUlps);
+	print_result("ens-float", floatUlps, r);
+	failures += r.failures;
+
+	r = run_regret_float(c);
+	print_result("reg-float", 0, r);
+	failures += r.failures;
+
+	r = run_fixed(c, deltaUlps, &pool);
+	print_result("fixed", deltaUlps, r);
+	failures += r.failures;
+
+	r = run_delta(c, deltaUlps, rng);
+	print_result("delta", deltaUlps, r);
+	failures += r.failures;
+
+	return failures > 0 ? 1 : EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/* enumerate.cpp
+ Exhaustive search over a subset of programs, printing the feasible
+ nondominated portfolios (option indices followed by objectives).
+
+ Usage: enumerate.exe [-M model] [-O base] -F programs
+   -M  model file (defaults to the table in modeldfn.h)
+   -O  option for the fixed programs, one value or a comma-separated list
+   -F  comma-separated list of the programs to enumerate, numbered from 1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include "enumerate.h"
+
+using namespace std;
+
+struct Archive {
+	int nPrograms;
+	int nConstraints;
+	vector<vector<int> > opts;
+	vector<vector<double> > objs;
+};
+
+static bool dominates(const double* a, const double* b) {
+	bool better = false;
+
+	for (int c = 0; c < nColumns; c++) {
+		if (a[c] > b[c]) return false;
+		if (a[c] < b[c]) better = true;
+	}
+
+	return better;
+}
+
+static bool archive_add(const int* opts, const double* objs, const double* consts, void* context) {
+	Archive* archive = (Archive*)context;
+
+	for (int i = 0; i < archive->nConstraints; i++)
+		if (consts[i] > 0) return true;
+
+	for (size_t i = 0; i < archive->objs.size(); i++)
+		if (dominates(&archive->objs[i][0], objs) || archive->objs[i] == vector<double>(objs, objs + nColumns))
+			return true;
+
+	for (size_t i = archive->objs.size(); i-- > 0;) {
+		if (dominates(objs, &archive->objs[i][0])) {
+			archive->objs.erase(archive->objs.begin() + i);
+			archive->opts.erase(archive->opts.begin() + i);
+		}
+	}
+
+	archive->opts.push_back(vector<int>(opts, opts + archive->nPrograms));
+	archive->objs.push_back(vector<double>(objs, objs + nColumns));
+	return true;
+}
+
+static vector<int> parse_list(const char* arg) {
+	vector<int> values;
+	char* end;
+
+	for (long value = strtol(arg, &end, 10); end != arg; value = strtol(arg, &end, 10)) {
+		values.push_back((int)value);
+		arg = (*end == ',') ? end + 1 : end;
+	}
+
+	return values;
+}
+
+int main(int argc, char* argv[]) {
+	const char* modelFile = NULL;
+	vector<int> base, freePrograms;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "M:O:F:")) != -1) {
+		switch (opt) {
+		case 'M':
+			modelFile = optarg;
+			break;
+		case 'O':
+			base = parse_list(optarg);
+			break;
+		case 'F':
+			freePrograms = parse_list(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-M model] [-O base] -F programs\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	PortfolioModel model;
+	Scenario scenario;
+	ScenarioTable table;
+
+	if (modelFile != NULL)
+		load_model(modelFile, model);
+	else
+		builtin_model(model);
+
+	default_scenario(model, scenario);
+	build_scenario_table(model, scenario, table);
+
+	if (base.size() <= 1) base.assign(model.nPrograms, base.empty() ? 0 : base[0]);
+	if ((int)base.size() != model.nPrograms) {
+		fprintf(stderr, "Expected one base option or one per program\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int progIdx = 0; progIdx < model.nPrograms; progIdx++)
+		base[progIdx] = option_index(base[progIdx], model.options(progIdx));
+
+	vector<bool> listed(model.nPrograms, false);
+	for (size_t i = 0; i < freePrograms.size(); i++) {
+		if (freePrograms[i] < 1 || freePrograms[i] > model.nPrograms) {
+			fprintf(stderr, "Program %d is not in the model\n", freePrograms[i]);
+			exit(EXIT_FAILURE);
+		}
+		if (listed[--freePrograms[i]]) {
+			fprintf(stderr, "Program %d is listed twice in -F\n", freePrograms[i] + 1);
+			exit(EXIT_FAILURE);
+		}
+		listed[freePrograms[i]] = true;
+	}
+
+	int* free = freePrograms.empty() ? NULL : &freePrograms[0];
+	if (count_portfolios(table, free, freePrograms.size()) > (1ULL << 40)) {
+		fprintf(stderr, "Too many portfolios to enumerate, reduce the number of free programs\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Archive archive;
+	archive.nPrograms = model.nPrograms;
+	archive.nConstraints = table.constraints();
+	uint64_t visited = enumerate_portfolios(table, &base[0], free, freePrograms.size(), archive_add, &archive);
+
+	for (size_t i = 0; i < archive.opts.size(); i++) {
+		for (int progIdx = 0; progIdx < model.nPrograms; progIdx++)
+			printf("%d ", archive.opts[i][progIdx]);
+		printf("%.17g %.17g %.17g\n", archive.objs[i][0], archive.objs[i][1], archive.objs[i][2]);
+	}
+
+	fprintf(stderr, "%llu portfolios enumerated, %d nondominated\n",
+			(unsigned long long)visited, (int)archive.opts.size());
+	return EXIT_SUCCESS;
+}
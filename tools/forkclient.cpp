@@ -0,0 +1,21 @@
+/* forkclient.cpp
+ Client of portfolio.exe's fork-server mode.  Hands its standard streams to
+ the server, which forks an evaluator with the model and tables already
+ built, and exits with that evaluator's exit status.  Spawn this in place of
+ portfolio.exe when a tool insists on a fresh process per run.
+
+ Usage: forkclient.exe socket
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "forkserver.h"
+
+int main(int argc, char* argv[]) {
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s socket\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	return fork_client(argv[1]);
+}
@@ -0,0 +1,59 @@
+/* genmodel.cpp
+ Writes a synthetic portfolio model in text form.
+
+ Usage: genmodel.exe [-P programs] [-m minOptions] [-x maxOptions] [-f budgetFraction] [-s seed] [-y years] [-o file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "synthetic.h"
+
+int main(int argc, char* argv[]) {
+	int nPrograms = 1000, minOptions = 2, maxOptions = 9;
+	double budgetFraction = 0.5;
+	unsigned int seed = 1;
+	int nYears = 0;
+	const char* output = "-";
+	int opt;
+
+	while ((opt = getopt(argc, argv, "P:m:x:f:s:y:o:")) != -1) {
+		switch (opt) {
+		case 'P':
+			nPrograms = atoi(optarg);
+			break;
+		case 'm':
+			minOptions = atoi(optarg);
+			break;
+		case 'x':
+			maxOptions = atoi(optarg);
+			break;
+		case 'f':
+			budgetFraction = atof(optarg);
+			break;
+		case 's':
+			seed = atoi(optarg);
+			break;
+		case 'y':
+			nYears = atoi(optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-P programs] [-m minOptions] [-x maxOptions] [-f budgetFraction] [-s seed] [-y years] [-o file]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (nPrograms < 1 || minOptions < 1 || maxOptions < minOptions || maxOptions > MAX_OPTIONS
+			|| nYears < 0 || nYears > MAX_YEARS) {
+		fprintf(stderr, "Invalid program, option or year counts\n");
+		exit(EXIT_FAILURE);
+	}
+
+	PortfolioModel model;
+	synthetic_model(model, nPrograms, minOptions, maxOptions, budgetFraction, seed, nYears);
+	save_model(output, model);
+	return EXIT_SUCCESS;
+}
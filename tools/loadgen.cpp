@@ -0,0 +1,438 @@
+/* loadgen.cpp
+ Borg-like load generator: drives portfolio.exe with a synthetic offspring
+ stream, the way Borg or the MOEA Framework would, and reports throughput
+ and round-trip latency.
+
+ A population of random portfolios evolves by steady-state replacement.  Each
+ offspring is a copy of a tournament-selected parent with every variable
+ perturbed with the mutation probability, so most offspring differ from their
+ parent in one or two programs and many decode to an already evaluated
+ portfolio; a further fraction are verbatim resubmissions of recent
+ offspring.  Offspring are sent in batches (1 for Borg's serial mode) and
+ each batch's results are awaited before the next is sent.
+
+ Round trips are timed per batch, from the first byte written to the last
+ result read, and per solution, from the batch being sent to that solution's
+ result arriving.
+
+ Usage: loadgen.exe [-e exe] [-x flags] [-T pipe|socket] [-N port] [-p population] [-b batch]
+                    [-n offspring | -t seconds] [-m mutation] [-d duplicates] [-s seed] [-o file]
+   -e  evaluator (default ./portfolio.exe)
+   -x  space-separated options passed to the evaluator, e.g. "-B 100 -M model.txt"
+   -T  transport: pipe (stdin/stdout, default) or socket (the evaluator's -N mode)
+   -N  TCP port for the socket transport (default 16801)
+   -p  population size (default 100); its initial evaluation is not timed
+   -b  offspring per batch (default 1)
+   -n  offspring to evaluate (default 100000), or -t to run for a time instead
+   -m  per-variable mutation probability (default 1/programs)
+   -d  fraction of offspring that repeat a recent offspring (default 0.1)
+   -s  random seed (default 1)
+   -o  file to write every per-solution round trip to, in microseconds
+ */
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "model.h"
+
+using namespace std;
+
+#define RECENT_OFFSPRING 1024
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct Member {
+	vector<double> vars;
+	double objs[nColumns];
+	double violation;
+};
+
+// Constrained dominance: feasible beats infeasible, lower violation beats
+// higher, otherwise Pareto dominance of the objectives.
+static bool dominates(const Member& a, const Member& b) {
+	if (a.violation != b.violation) return a.violation < b.violation;
+
+	bool better = false;
+	for (int c = 0; c < nColumns; c++) {
+		if (a.objs[c] > b.objs[c]) return false;
+		if (a.objs[c] < b.objs[c]) better = true;
+	}
+	return better;
+}
+
+struct Connection {
+	pid_t pid;
+	int writeFd;
+	int readFd;
+	string pending; // partial result line
+};
+
+static pid_t spawn(const char* exe, const char* flags, const char* port, int* stdinFd, int* stdoutFd) {
+	int toChild[2], fromChild[2];
+	if (stdinFd != NULL && (pipe(toChild) != 0 || pipe(fromChild) != 0)) {
+		perror("pipe");
+		exit(EXIT_FAILURE);
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (stdinFd != NULL) {
+			dup2(toChild[0], STDIN_FILENO);
+			dup2(fromChild[1], STDOUT_FILENO);
+			close(toChild[0]);
+			close(toChild[1]);
+			close(fromChild[0]);
+			close(fromChild[1]);
+		}
+
+		vector<char*> args(1, (char*)exe);
+		for (char* p = strtok(strdup(flags), " "); p != NULL; p = strtok(NULL, " "))
+			args.push_back(p);
+		if (port != NULL) {
+			args.push_back((char*)"-N");
+			args.push_back((char*)port);
+		}
+		args.push_back(NULL);
+
+		execv(exe, &args[0]);
+		fprintf(stderr, "Unable to run %s\n", exe);
+		_exit(EXIT_FAILURE);
+	}
+
+	if (stdinFd != NULL) {
+		close(toChild[0]);
+		close(fromChild[1]);
+		*stdinFd = toChild[1];
+		*stdoutFd = fromChild[0];
+	}
+
+	return pid;
+}
+
+// Connects to the evaluator's port, retrying while it starts up.
+static int connect_port(const char* port) {
+	struct addrinfo hints, *servinfo;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	for (int attempt = 0; attempt < 500; attempt++) {
+		if (getaddrinfo("localhost", port, &hints, &servinfo) != 0) break;
+
+		for (struct addrinfo* sp = servinfo; sp != NULL; sp = sp->ai_next) {
+			int fd = socket(sp->ai_family, sp->ai_socktype, sp->ai_protocol);
+			if (fd == -1) continue;
+
+			if (connect(fd, sp->ai_addr, sp->ai_addrlen) == 0) {
+				/* a batch is several writes; do not wait for ACKs between them */
+				int yes = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+				freeaddrinfo(servinfo);
+				return fd;
+			}
+			close(fd);
+		}
+
+		freeaddrinfo(servinfo);
+		usleep(10000);
+	}
+
+	fprintf(stderr, "Unable to connect to port %s\n", port);
+	exit(EXIT_FAILURE);
+}
+
+// Sends text and reads one result line per solution into results, recording
+// the time at which each arrived.
+static void round_trip(Connection& conn, const string& text, int nSend, vector<Member*>& results,
+		vector<double>& arrival) {
+	size_t from = 0;
+	int received = 0;
+	char buffer[65536];
+	struct pollfd fds[2] = { { conn.writeFd, POLLOUT, 0 }, { conn.readFd, POLLIN, 0 } };
+
+	while (received < nSend) {
+		fds[0].fd = (from < text.size()) ? conn.writeFd : -1;
+		if (poll(fds, 2, -1) < 0) continue;
+
+		if (fds[0].revents & (POLLOUT | POLLERR)) {
+			ssize_t written = write(conn.writeFd, text.data() + from, text.size() - from);
+			if (written > 0) from += written;
+		}
+
+		if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+			ssize_t got = read(conn.readFd, buffer, sizeof(buffer));
+			if (got <= 0) {
+				fprintf(stderr, "The evaluator exited early\n");
+				exit(EXIT_FAILURE);
+			}
+
+			double t = now();
+			conn.pending.append(buffer, got);
+
+			size_t start = 0, end;
+			while ((end = conn.pending.find('\n', start)) != string::npos) {
+				Member* m = results[received];
+				const char* p = conn.pending.c_str() + start;
+				char* next;
+
+				for (int c = 0; c < nColumns; c++) {
+					m->objs[c] = strtod(p, &next);
+					p = next;
+				}
+				m->violation = 0;
+				for (double v = strtod(p, &next); next != p; v = strtod(p, &next)) {
+					m->violation += v;
+					p = next;
+				}
+
+				arrival[received++] = t;
+				start = end + 1;
+			}
+			conn.pending.erase(0, start);
+		}
+	}
+}
+
+static void append_solution(string& text, const vector<double>& vars) {
+	char value[32];
+
+	for (size_t i = 0; i < vars.size(); i++) {
+		snprintf(value, sizeof(value), i + 1 < vars.size() ? "%.17g " : "%.17g\n", vars[i]);
+		text += value;
+	}
+}
+
+static double percentile(const vector<double>& sorted, double q) {
+	return sorted[min(sorted.size() - 1, (size_t)(q * sorted.size()))];
+}
+
+static void print_latencies(const char* name, vector<double>& latency) {
+	if (latency.empty()) return;
+	sort(latency.begin(), latency.end());
+
+	double mean = 0;
+	for (size_t i = 0; i < latency.size(); i++)
+		mean += latency[i];
+	mean /= latency.size();
+
+	printf("%-9s %10zu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, latency.size(), 1e6 * mean,
+			1e6 * percentile(latency, 0), 1e6 * percentile(latency, 0.5), 1e6 * percentile(latency, 0.9),
+			1e6 * percentile(latency, 0.99), 1e6 * percentile(latency, 0.999), 1e6 * latency.back());
+}
+
+int main(int argc, char* argv[]) {
+	const char* exe = "./portfolio.exe";
+	const char* flags = "";
+	const char* port = "16801";
+	const char* output = NULL;
+	bool useSocket = false;
+	int population = 100;
+	int batch = 1;
+	long nOffspring = 100000;
+	double duration = 0;
+	double mutation = -1;
+	double duplicates = 0.1;
+	unsigned int seed = 1;
+	const char* modelFile = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "e:x:T:N:p:b:n:t:m:d:s:o:")) != -1) {
+		switch (opt) {
+		case 'e':
+			exe = optarg;
+			break;
+		case 'x':
+			flags = optarg;
+			break;
+		case 'T':
+			useSocket = (strcmp(optarg, "socket") == 0);
+			if (!useSocket && strcmp(optarg, "pipe") != 0) {
+				fprintf(stderr, "Unknown transport %s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'N':
+			port = optarg;
+			break;
+		case 'p':
+			population = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 'n':
+			nOffspring = atol(optarg);
+			break;
+		case 't':
+			duration = atof(optarg);
+			break;
+		case 'm':
+			mutation = atof(optarg);
+			break;
+		case 'd':
+			duplicates = atof(optarg);
+			break;
+		case 's':
+			seed = atoi(optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-e exe] [-x flags] [-T pipe|socket] [-N port] [-p population] [-b batch] "
+					"[-n offspring | -t seconds] [-m mutation] [-d duplicates] [-s seed] [-o file]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (population < 2 || batch < 1) {
+		fprintf(stderr, "Need a population of at least 2 and batches of at least 1\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* the evaluator's model gives the number of programs and their options */
+	PortfolioModel model;
+	vector<char*> words;
+	string flagCopy(flags);
+	for (char* p = strtok(&flagCopy[0], " "); p != NULL; p = strtok(NULL, " "))
+		words.push_back(p);
+	for (size_t i = 0; i + 1 < words.size(); i++)
+		if (strcmp(words[i], "-M") == 0) modelFile = words[i + 1];
+
+	if (modelFile != NULL)
+		load_model(modelFile, model);
+	else
+		builtin_model(model);
+
+	const int n = model.nPrograms;
+	if (mutation < 0) mutation = 1.0 / n;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	Connection conn;
+	if (useSocket) {
+		conn.pid = spawn(exe, flags, port, NULL, NULL);
+		conn.readFd = conn.writeFd = connect_port(port);
+	} else {
+		conn.pid = spawn(exe, flags, NULL, &conn.writeFd, &conn.readFd);
+	}
+
+	mt19937 rng(seed);
+	uniform_real_distribution<double> uniform(0.0, 1.0);
+	normal_distribution<double> step(0.0, 1.0);
+
+	/* initial population, evaluated as one untimed batch */
+	vector<Member> members(population);
+	vector<Member*> results;
+	vector<double> arrival(max(population, batch));
+	string text;
+
+	for (int i = 0; i < population; i++) {
+		members[i].vars.resize(n);
+		for (int progIdx = 0; progIdx < n; progIdx++)
+			members[i].vars[progIdx] = model.options(progIdx) * uniform(rng);
+		append_solution(text, members[i].vars);
+		results.push_back(&members[i]);
+	}
+	round_trip(conn, text, population, results, arrival);
+
+	/* steady-state evolution */
+	vector<Member> offspring(batch);
+	vector<vector<double> > recent;
+	vector<double> batchLatency, solutionLatency;
+	long evaluated = 0, repeats = 0;
+	double start = now();
+
+	for (int i = 0; i < batch; i++)
+		results[i] = &offspring[i];
+
+	while (duration > 0 ? now() - start < duration : evaluated < nOffspring) {
+		int nSend = (duration > 0) ? batch : (int)min((long)batch, nOffspring - evaluated);
+		text.clear();
+
+		for (int i = 0; i < nSend; i++) {
+			Member& child = offspring[i];
+
+			if (!recent.empty() && uniform(rng) < duplicates) {
+				child.vars = recent[rng() % recent.size()];
+				repeats++;
+			} else {
+				const Member& a = members[rng() % population];
+				const Member& b = members[rng() % population];
+				child.vars = dominates(b, a) ? b.vars : a.vars;
+
+				for (int progIdx = 0; progIdx < n; progIdx++) {
+					if (uniform(rng) >= mutation) continue;
+
+					double limit = nextafter((double)model.options(progIdx), 0.0);
+					child.vars[progIdx] = min(limit, max(0.0, child.vars[progIdx] + 0.5 * step(rng)));
+				}
+
+				if (recent.size() < RECENT_OFFSPRING)
+					recent.push_back(child.vars);
+				else
+					recent[rng() % RECENT_OFFSPRING] = child.vars;
+			}
+
+			append_solution(text, child.vars);
+		}
+
+		double sent = now();
+		round_trip(conn, text, nSend, results, arrival);
+
+		batchLatency.push_back(arrival[nSend - 1] - sent);
+		for (int i = 0; i < nSend; i++) {
+			solutionLatency.push_back(arrival[i] - sent);
+
+			/* replace a random member the offspring dominates */
+			Member& victim = members[rng() % population];
+			if (dominates(offspring[i], victim))
+				victim = offspring[i];
+		}
+		evaluated += nSend;
+	}
+
+	double elapsed = now() - start;
+
+	if (useSocket) shutdown(conn.writeFd, SHUT_WR);
+	close(conn.writeFd);
+	if (conn.readFd != conn.writeFd) close(conn.readFd);
+	waitpid(conn.pid, NULL, 0);
+
+	if (output != NULL) {
+		FILE* file = fopen(output, "w");
+		if (file == NULL) {
+			fprintf(stderr, "Unable to open %s\n", output);
+			exit(EXIT_FAILURE);
+		}
+		for (size_t i = 0; i < solutionLatency.size(); i++)
+			fprintf(file, "%.3f\n", 1e6 * solutionLatency[i]);
+		fclose(file);
+	}
+
+	printf("%ld offspring in %.3f s over %s: %.0f evals/s, %.1f%% resubmitted\n", evaluated, elapsed,
+			useSocket ? "socket" : "pipe", evaluated / elapsed, 100.0 * repeats / max(1L, evaluated));
+	printf("%-9s %10s %9s %9s %9s %9s %9s %9s %9s\n", "latency", "count", "mean-us", "min", "p50", "p90", "p99",
+			"p99.9", "max");
+	print_latencies("batch", batchLatency);
+	print_latencies("solution", solutionLatency);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+/* prim.cpp
+ PRIM scenario discovery: finds the box of scenarios in which outcomes
+ exceed a threshold, by default those where a portfolio breaks its budget.
+
+ Usage: prim.exe -X scenarios [-Y outcomes | -O options [-M model]]
+                 [-t threshold] [-a alpha] [-m support] [-i step] [-J threads]
+   -X  scenario file, one scenario per line (e.g. from scengen.exe): either
+       the multipliers of every program or those followed by the bau, ss,
+       cost and budget scales
+   -Y  outcome file, one value per scenario
+   -O  instead of -Y, evaluate this portfolio (one option index or a
+       comma-separated list) and use its budget constraint, consts[0]
+   -M  model file for -O (defaults to the table in modeldfn.h)
+   -t  scenarios with an outcome above this value are cases (default 0)
+   -a  fraction of the box peeled per step (default 0.05)
+   -m  minimum share of scenarios in a box (default 0.05)
+   -i  trajectory step whose box is printed (default: the last)
+   -J  threads (default: hardware threads)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ensemble.h"
+#include "prim.h"
+
+using namespace std;
+
+static vector<int> parse_list(const char* arg) {
+	vector<int> values;
+	char* end;
+
+	for (long value = strtol(arg, &end, 10); end != arg; value = strtol(arg, &end, 10)) {
+		values.push_back((int)value);
+		arg = (*end == ',') ? end + 1 : end;
+	}
+
+	return values;
+}
+
+// Reads whitespace separated rows into a matrix stored column by column.
+static void read_rows(const char* filename, vector<double>& x, int& nRows, int& nCols) {
+	ifstream in(filename);
+	vector<vector<double> > rows;
+	string line;
+
+	if (!in.is_open()) {
+		fprintf(stderr, "Error opening file %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	while (getline(in, line)) {
+		istringstream fields(line);
+		vector<double> row;
+		double value;
+
+		while (fields >> value)
+			row.push_back(value);
+		if (row.empty()) continue;
+
+		if (!rows.empty() && row.size() != rows[0].size()) {
+			fprintf(stderr, "%s: line %d has %d values, expected %d\n", filename, (int)rows.size() + 1,
+					(int)row.size(), (int)rows[0].size());
+			exit(EXIT_FAILURE);
+		}
+		rows.push_back(row);
+	}
+
+	nRows = (int)rows.size();
+	nCols = rows.empty() ? 0 : (int)rows[0].size();
+	x.resize((size_t)nRows * nCols);
+
+	for (int i = 0; i < nRows; i++)
+		for (int d = 0; d < nCols; d++)
+			x[(size_t)d * nRows + i] = rows[i][d];
+}
+
+int main(int argc, char* argv[]) {
+	const char* scenarioFile = NULL;
+	const char* outcomeFile = NULL;
+	const char* modelFile = NULL;
+	vector<int> opts;
+	double threshold = 0.0;
+	PrimOptions options = { 0.05, 0.05 };
+	int step = -1;
+	int nThreads = hardware_threads();
+	int opt;
+
+	while ((opt = getopt(argc, argv, "X:Y:O:M:t:a:m:i:J:")) != -1) {
+		switch (opt) {
+		case 'X':
+			scenarioFile = optarg;
+			break;
+		case 'Y':
+			outcomeFile = optarg;
+			break;
+		case 'O':
+			opts = parse_list(optarg);
+			break;
+		case 'M':
+			modelFile = optarg;
+			break;
+		case 't':
+			threshold = atof(optarg);
+			break;
+		case 'a':
+			options.alpha = atof(optarg);
+			break;
+		case 'm':
+			options.minSupport = atof(optarg);
+			break;
+		case 'i':
+			step = atoi(optarg);
+			break;
+		case 'J':
+			nThreads = atoi(optarg) > 0 ? atoi(optarg) : hardware_threads();
+			break;
+		default:
+			fprintf(stderr, "Usage: %s -X scenarios [-Y outcomes | -O options [-M model]] [-t threshold] "
+					"[-a alpha] [-m support] [-i step] [-J threads]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (scenarioFile == NULL || (outcomeFile == NULL) == opts.empty()) {
+		fprintf(stderr, "Give a scenario file and either an outcome file or a portfolio\n");
+		exit(EXIT_FAILURE);
+	}
+
+	vector<double> x;
+	int nPoints, nDims;
+	read_rows(scenarioFile, x, nPoints, nDims);
+
+	vector<double> y;
+	PortfolioModel model;
+	bool named = false;
+
+	if (outcomeFile != NULL) {
+		int nOutcomes, nValues;
+		read_rows(outcomeFile, y, nOutcomes, nValues);
+		if (nOutcomes != nPoints || nValues != 1) {
+			fprintf(stderr, "Expected one outcome for each of the %d scenarios\n", nPoints);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		if (modelFile != NULL)
+			load_model(modelFile, model);
+		else
+			builtin_model(model);
+
+		const int n = model.nPrograms;
+		if (nDims != n && nDims != SCENARIO_INPUTS(n)) {
+			fprintf(stderr, "Scenarios have %d values, expected %d or %d\n", nDims, n, SCENARIO_INPUTS(n));
+			exit(EXIT_FAILURE);
+		}
+
+		if (opts.size() == 1) opts.assign(n, opts[0]);
+		if ((int)opts.size() != n) {
+			fprintf(stderr, "Expected one option or one per program\n");
+			exit(EXIT_FAILURE);
+		}
+		for (int progIdx = 0; progIdx < n; progIdx++)
+			opts[progIdx] = option_index(opts[progIdx], model.options(progIdx));
+
+		/* scenarios without scales run at scale 1 */
+		vector<double> inputs(x);
+		inputs.resize((size_t)SCENARIO_INPUTS(n) * nPoints, 1.0);
+
+		vector<double> outputs((size_t)ENSEMBLE_OUTPUTS * nPoints);
+		evaluate_ensemble(model, &opts[0], &inputs[0], nPoints, &outputs[0]);
+		y.assign(outputs.begin() + (size_t)3 * nPoints, outputs.end());
+		named = true;
+	}
+
+	boost::dynamic_bitset<> cases(nPoints);
+	for (int i = 0; i < nPoints; i++)
+		cases[i] = y[i] > threshold;
+
+	ThreadPool pool(nThreads);
+	vector<PrimBox> trajectory;
+	prim_peel(&x[0], nPoints, nDims, cases, options, trajectory, &pool);
+
+	printf("%6s %10s %10s %10s %8s\n", "step", "coverage", "density", "support", "inputs");
+	for (size_t s = 0; s < trajectory.size(); s++) {
+		int restricted = 0;
+		for (int d = 0; d < nDims; d++)
+			restricted += trajectory[s].lower[d] > trajectory[0].lower[d] || trajectory[s].upper[d] < trajectory[0].upper[d];
+
+		printf("%6d %10.4f %10.4f %10.4f %8d\n", (int)s, trajectory[s].coverage, trajectory[s].density,
+				trajectory[s].support, restricted);
+	}
+
+	if (step < 0 || step >= (int)trajectory.size()) step = (int)trajectory.size() - 1;
+	const PrimBox& box = trajectory[step];
+	const char* scales[4] = { "bau_scale", "ss_scale", "cost_scale", "budget_scale" };
+
+	printf("\nbox %d: %d scenarios, %d cases\n", step, box.nInside, box.nCases);
+	for (int d = 0; d < nDims; d++) {
+		if (box.lower[d] == trajectory[0].lower[d] && box.upper[d] == trajectory[0].upper[d]) continue;
+
+		char name[32];
+		if (!named)
+			snprintf(name, sizeof(name), "x%d", d + 1);
+		else if (d < model.nPrograms)
+			snprintf(name, sizeof(name), "u%d", d + 1);
+		else
+			snprintf(name, sizeof(name), "%s", scales[d - model.nPrograms]);
+
+		printf("  %-12s [%g, %g]\n", name, box.lower[d], box.upper[d]);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,281 @@
+/* replay.cpp
+ Replays an evaluation trace captured with portfolio.exe -T through the
+ evaluation paths at full speed, and checks each path's objectives and
+ constraints bitwise against the captured results.
+
+ Each path evaluates the whole trace (repeated -r times) into memory; only
+ that is timed.  Records of daemon 'multipliers' requests cannot be replayed
+ and are skipped.  Exits with status 1 if any path disagrees with the trace.
+
+ Usage: replay.exe [-M model] [-X library] [-p paths] [-r repeats] [-J threads] trace
+   -M  model file the trace was captured with (default: the built-in model)
+   -X  scenario library the daemon was given, for traces that select scenarios
+   -p  comma-separated paths: problem, table, packed, batch (default: all)
+   -r  times to run through the trace per path (default 1)
+   -J  threads for the batch path (default 1)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "ensemble.h"
+#include "trace.h"
+
+using namespace std;
+
+#define REPLAY_BATCH 256
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct ReplayScenario {
+	Scenario scenario;
+	ScenarioTable table;
+};
+
+struct Replay {
+	const PortfolioModel* model;
+	const Trace* trace;
+	GenomeLayout layout;
+	vector<ReplayScenario> scenarios;
+	vector<size_t> records;         // replayable records
+	vector<int> scenarioIndex;      // per replayable record
+	vector<uint8_t> opts;           // per replayable record, unpacked
+	vector<double> vars;            // middle of each option's interval
+	vector<double> objs;
+	vector<double> consts;
+	ThreadPool* pool;
+};
+
+static void run_problem(Replay& r) {
+	const int n = r.model->nPrograms, nConsts = r.trace->nConstraints;
+	for (size_t i = 0; i < r.records.size(); i++)
+		portfolio_problem(*r.model, r.scenarios[r.scenarioIndex[i]].scenario, &r.vars[i * n],
+				&r.objs[i * nColumns], &r.consts[i * nConsts]);
+}
+
+static void run_table(Replay& r) {
+	const int n = r.model->nPrograms, nConsts = r.trace->nConstraints;
+	vector<int> opts(n);
+	for (size_t i = 0; i < r.records.size(); i++) {
+		copy(&r.opts[i * n], &r.opts[(i + 1) * n], opts.begin());
+		evaluate_options(r.scenarios[r.scenarioIndex[i]].table, &opts[0], &r.objs[i * nColumns],
+				&r.consts[i * nConsts]);
+	}
+}
+
+static void run_packed(Replay& r) {
+	const int nConsts = r.trace->nConstraints;
+	for (size_t i = 0; i < r.records.size(); i++)
+		evaluate_packed(r.scenarios[r.scenarioIndex[i]].table, r.layout, r.trace->genome(r.records[i]),
+				&r.objs[i * nColumns], &r.consts[i * nConsts]);
+}
+
+// Runs of consecutive records under one scenario, up to REPLAY_BATCH at a time.
+static void run_batch(Replay& r) {
+	const int n = r.model->nPrograms, nConsts = r.trace->nConstraints;
+	size_t first = 0;
+
+	while (first < r.records.size()) {
+		size_t last = first + 1;
+		while (last < r.records.size() && last - first < REPLAY_BATCH && r.scenarioIndex[last] == r.scenarioIndex[first])
+			last++;
+
+		evaluate_batch(r.scenarios[r.scenarioIndex[first]].table, &r.opts[first * n], (int)(last - first),
+				&r.objs[first * nColumns], &r.consts[first * nConsts], r.pool);
+		first = last;
+	}
+}
+
+// Number of records whose results differ in any bit from the trace.
+static long compare(const Replay& r, bool verbose) {
+	const int nConsts = r.trace->nConstraints;
+	long mismatches = 0;
+
+	for (size_t i = 0; i < r.records.size(); i++) {
+		size_t rec = r.records[i];
+		if (memcmp(&r.objs[i * nColumns], r.trace->objs(rec), nColumns * sizeof(double)) == 0 &&
+				memcmp(&r.consts[i * nConsts], r.trace->consts(rec), nConsts * sizeof(double)) == 0)
+			continue;
+
+		if (mismatches++ == 0 && verbose) {
+			printf("  first mismatch at record %zu:\n    trace ", rec);
+			for (int c = 0; c < nColumns + nConsts; c++)
+				printf(" %.17g", r.trace->objs(rec)[c]);
+			printf("\n    replay");
+			for (int c = 0; c < nColumns; c++)
+				printf(" %.17g", r.objs[i * nColumns + c]);
+			for (int c = 0; c < nConsts; c++)
+				printf(" %.17g", r.consts[i * nConsts + c]);
+			printf("\n");
+		}
+	}
+
+	return mismatches;
+}
+
+int main(int argc, char* argv[]) {
+	const char* modelFile = NULL;
+	const char* libraryFile = NULL;
+	vector<string> paths;
+	int repeats = 1;
+	int nThreads = 1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "M:X:p:r:J:")) != -1) {
+		switch (opt) {
+		case 'M':
+			modelFile = optarg;
+			break;
+		case 'X':
+			libraryFile = optarg;
+			break;
+		case 'p':
+			for (char* p = strtok(optarg, ","); p != NULL; p = strtok(NULL, ","))
+				paths.push_back(p);
+			break;
+		case 'r':
+			repeats = max(1, atoi(optarg));
+			break;
+		case 'J':
+			nThreads = max(1, atoi(optarg));
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-M model] [-X library] [-p paths] [-r repeats] [-J threads] trace\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (optind != argc - 1) {
+		fprintf(stderr, "Usage: %s [-M model] [-X library] [-p paths] [-r repeats] [-J threads] trace\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	if (paths.empty()) {
+		const char* all[] = { "problem", "table", "packed", "batch" };
+		paths.assign(all, all + 4);
+	}
+
+	PortfolioModel model;
+	if (modelFile != NULL)
+		load_model(modelFile, model);
+	else
+		builtin_model(model);
+
+	Trace trace;
+	read_trace(argv[optind], trace);
+
+	const int n = model.nPrograms;
+	bool sameModel = (trace.nPrograms == n);
+	for (int progIdx = 0; sameModel && progIdx < n; progIdx++)
+		sameModel = (trace.options[progIdx] == model.options(progIdx));
+	if (!sameModel) {
+		fprintf(stderr, "The trace was captured with a different model\n");
+		exit(EXIT_FAILURE);
+	}
+
+	vector<double> library;
+	int nLibrary = 0;
+	if (libraryFile != NULL)
+		load_scenarios(libraryFile, model, library, nLibrary);
+
+	/* the scenarios the trace uses, the base scenario first */
+	Replay r;
+	r.model = &model;
+	r.trace = &trace;
+	build_genome_layout(model, r.layout);
+
+	map<uint32_t, int> scenarioIds;
+	r.scenarios.resize(1);
+	scenario_from_inputs(model, &trace.baseInputs[0], 1, 0, r.scenarios[0].scenario);
+	scenarioIds[TRACE_SCENARIO_BASE] = 0;
+	size_t skipped = 0;
+
+	for (size_t rec = 0; rec < trace.nRecords; rec++) {
+		uint32_t id = trace.scenario(rec);
+		if (id == TRACE_SCENARIO_INLINE) {
+			skipped++;
+			continue;
+		}
+
+		if (scenarioIds.find(id) == scenarioIds.end()) {
+			if (id >= (uint32_t)nLibrary) {
+				fprintf(stderr, "Record %zu selects scenario %u; give the daemon's library with -X\n", rec, id);
+				exit(EXIT_FAILURE);
+			}
+
+			scenarioIds[id] = (int)r.scenarios.size();
+			r.scenarios.push_back(ReplayScenario());
+			scenario_from_inputs(model, &library[0], nLibrary, id, r.scenarios.back().scenario);
+		}
+
+		r.records.push_back(rec);
+		r.scenarioIndex.push_back(scenarioIds[id]);
+	}
+
+	for (size_t i = 0; i < r.scenarios.size(); i++)
+		build_scenario_table(model, r.scenarios[i].scenario, r.scenarios[i].table);
+
+	if (r.scenarios[0].table.constraints() != trace.nConstraints) {
+		fprintf(stderr, "The trace has %d constraints, the model %d\n", trace.nConstraints,
+				r.scenarios[0].table.constraints());
+		exit(EXIT_FAILURE);
+	}
+
+	const size_t nReplay = r.records.size();
+	vector<int> opts(n);
+	r.opts.resize(nReplay * n);
+	r.vars.resize(nReplay * n);
+	for (size_t i = 0; i < nReplay; i++) {
+		unpack_genome(r.layout, trace.genome(r.records[i]), &opts[0]);
+		for (int progIdx = 0; progIdx < n; progIdx++) {
+			r.opts[i * n + progIdx] = (uint8_t)opts[progIdx];
+			r.vars[i * n + progIdx] = opts[progIdx] + 0.5;
+		}
+	}
+	r.objs.resize(nReplay * nColumns);
+	r.consts.resize(nReplay * trace.nConstraints);
+
+	ThreadPool pool(nThreads);
+	r.pool = &pool;
+
+	double span = trace.nRecords > 0 ? trace.time(trace.nRecords - 1) * 1e-9 : 0;
+	printf("%zu records over %.3f s of capture (%zu skipped), %zu scenarios\n", trace.nRecords, span, skipped,
+			r.scenarios.size());
+	printf("%-10s %14s %12s\n", "path", "evals/s", "mismatches");
+
+	long failures = 0;
+	for (size_t p = 0; p < paths.size(); p++) {
+		void (*body)(Replay&) = NULL;
+		if (paths[p] == "problem") body = run_problem;
+		else if (paths[p] == "table") body = run_table;
+		else if (paths[p] == "packed") body = run_packed;
+		else if (paths[p] == "batch") body = run_batch;
+		else {
+			fprintf(stderr, "Unknown path %s\n", paths[p].c_str());
+			exit(EXIT_FAILURE);
+		}
+
+		fill(r.objs.begin(), r.objs.end(), -1.0);
+		double start = now();
+		for (int i = 0; i < repeats; i++)
+			body(r);
+		double elapsed = now() - start;
+
+		long mismatches = compare(r, false);
+		printf("%-10s %14.0f %12ld\n", paths[p].c_str(), repeats * nReplay / elapsed, mismatches);
+		if (mismatches > 0) compare(r, true);
+		failures += mismatches;
+	}
+
+	return failures > 0 ? 1 : EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/* scalebench.cpp
+ Evaluations per second as the number of programs grows, for the scalar
+ table path, the batched path on one and on all threads, and the
+ constraint-first batched path on all threads.
+
+ Usage: scalebench.exe [-P counts] [-n batch] [-J threads] [-t seconds] [-f budget]
+   -P  comma-separated program counts (default 22,100,1000,2000,5000,10000)
+   -n  solutions per batch (default 256)
+   -J  threads for the parallel batch path (default: hardware threads)
+   -t  minimum time per measurement in seconds (default 0.5)
+   -f  budget as a fraction of the cost of funding everything (default 0.5)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "batch.h"
+#include "synthetic.h"
+
+using namespace std;
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct Fixture {
+	const ScenarioTable* table;
+	const vector<double>* vars;
+	const vector<uint8_t>* opts;
+	int nSolutions;
+	vector<double> objs;
+	vector<double> consts;
+	ThreadPool* pool;
+};
+
+static void run_scalar(Fixture& f) {
+	int nPrograms = f.table->nPrograms;
+	for (int s = 0; s < f.nSolutions; s++)
+		evaluate_table(*f.table, &(*f.vars)[s * nPrograms], &f.objs[s * nColumns], &f.consts[s]);
+}
+
+static void run_batch(Fixture& f) {
+	evaluate_batch(*f.table, &(*f.opts)[0], f.nSolutions, &f.objs[0], &f.consts[0], f.pool);
+}
+
+static void run_screened(Fixture& f) {
+	evaluate_batch_screened(*f.table, &(*f.opts)[0], f.nSolutions, &f.objs[0], &f.consts[0], f.pool);
+}
+
+// Repeats a batch until minTime has passed and returns evaluations per second.
+static double measure(void (*body)(Fixture&), Fixture& f, double minTime) {
+	body(f); // warm up
+
+	long evaluations = 0;
+	double start = now(), elapsed;
+	do {
+		body(f);
+		evaluations += f.nSolutions;
+		elapsed = now() - start;
+	} while (elapsed < minTime);
+
+	return evaluations / elapsed;
+}
+
+int main(int argc, char* argv[]) {
+	vector<int> counts;
+	int nSolutions = 256;
+	int nThreads = hardware_threads();
+	double minTime = 0.5;
+	double budgetFraction = 0.5;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "P:n:J:t:f:")) != -1) {
+		switch (opt) {
+		case 'P':
+			for (char* p = strtok(optarg, ","); p != NULL; p = strtok(NULL, ","))
+				counts.push_back(atoi(p));
+			break;
+		case 'n':
+			nSolutions = atoi(optarg);
+			break;
+		case 'J':
+			nThreads = atoi(optarg);
+			break;
+		case 't':
+			minTime = atof(optarg);
+			break;
+		case 'f':
+			budgetFraction = atof(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-P counts] [-n batch] [-J threads] [-t seconds] [-f budget]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (counts.empty()) {
+		int defaults[] = { 22, 100, 1000, 2000, 5000, 10000 };
+		counts.assign(defaults, defaults + 6);
+	}
+
+	ThreadPool pool(nThreads);
+	printf("%10s %14s %14s %14s %14s %10s\n", "programs", "scalar/s", "batch/s", "batch-mt/s", "screen-mt/s",
+			"infeasible");
+
+	for (size_t i = 0; i < counts.size(); i++) {
+		PortfolioModel model;
+		Scenario scenario;
+		ScenarioTable table;
+
+		synthetic_model(model, counts[i], 2, 9, budgetFraction, 1);
+		default_scenario(model, scenario);
+		build_scenario_table(model, scenario, table);
+
+		vector<double> vars((size_t)nSolutions * model.nPrograms);
+		vector<uint8_t> opts(vars.size());
+		srand(1);
+		for (int s = 0; s < nSolutions; s++) {
+			for (int progIdx = 0; progIdx < model.nPrograms; progIdx++)
+				vars[(size_t)s * model.nPrograms + progIdx] = model.options(progIdx) * (rand() / (RAND_MAX + 1.0));
+			decode_options(table, &vars[(size_t)s * model.nPrograms], &opts[(size_t)s * model.nPrograms]);
+		}
+
+		Fixture f;
+		f.table = &table;
+		f.vars = &vars;
+		f.opts = &opts;
+		f.nSolutions = nSolutions;
+		f.objs.resize(nSolutions * nColumns);
+		f.consts.resize(nSolutions);
+
+		f.pool = NULL;
+		double scalar = measure(run_scalar, f, minTime);
+		double batch = measure(run_batch, f, minTime);
+		f.pool = &pool;
+		double parallel = measure(run_batch, f, minTime);
+		double screened = measure(run_screened, f, minTime);
+		int infeasible = evaluate_batch_screened(table, &opts[0], nSolutions, &f.objs[0], &f.consts[0], &pool);
+
+		printf("%10d %14.0f %14.0f %14.0f %14.0f %9.0f%%\n", counts[i], scalar, batch, parallel, screened,
+				100.0 * infeasible / nSolutions);
+		fflush(stdout);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+/* scengen.cpp
+ Correlated scenario generator.  Prints one scenario per line: the lognormal
+ uncertainty multiplier of every program, correlated through the given
+ correlation matrix (independent when none is given).  With -b it instead
+ compares the rate at which scenarios are sampled with the rate at which the
+ batched evaluator gets through solutions.
+
+ Usage: scengen.exe [-M model] [-K correlation] [-n scenarios] [-G sigma[,mean]]
+                    [-s seed] [-J threads] [-b]
+   -M  model file (default: the compiled-in model)
+   -K  nPrograms x nPrograms correlation matrix
+   -n  number of scenarios (default 100)
+   -G  log-scale standard deviation and mean of the multipliers (default 0.1,1)
+   -s  random seed (default 1)
+   -J  threads (default 1, 0 for one per hardware thread)
+   -b  benchmark instead of printing
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "batch.h"
+#include "correlate.h"
+
+using namespace std;
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void benchmark(const PortfolioModel& model, CorrelatedSampler& sampler, int nScenarios,
+		double sigma, double mean, ThreadPool* pool) {
+	const int nPrograms = model.nPrograms;
+	const double minTime = 0.5;
+	vector<double> multipliers((size_t)nPrograms * nScenarios);
+	long count = 0;
+	double start = now(), elapsed;
+
+	do {
+		correlated_multipliers(sampler, nScenarios, sigma, mean, &multipliers[0], pool);
+		count += nScenarios;
+		elapsed = now() - start;
+	} while (elapsed < minTime);
+	double scenarioRate = count / elapsed;
+
+	Scenario scenario;
+	ScenarioTable table;
+	default_scenario(model, scenario);
+	build_scenario_table(model, scenario, table);
+
+	vector<uint8_t> opts((size_t)nScenarios * nPrograms);
+	vector<double> objs((size_t)nScenarios * nColumns), consts((size_t)nScenarios * table.constraints());
+	srand(1);
+	for (size_t i = 0; i < opts.size(); i++)
+		opts[i] = (uint8_t)(rand() % table.options(i % nPrograms));
+
+	count = 0;
+	start = now();
+	do {
+		evaluate_batch(table, &opts[0], nScenarios, &objs[0], &consts[0], pool);
+		count += nScenarios;
+		elapsed = now() - start;
+	} while (elapsed < minTime);
+	double evalRate = count / elapsed;
+
+	printf("%10s %14s %14s\n", "programs", "scenarios/s", "evals/s");
+	printf("%10d %14.0f %14.0f\n", nPrograms, scenarioRate, evalRate);
+}
+
+int main(int argc, char* argv[]) {
+	const char* modelFile = NULL;
+	const char* correlationFile = NULL;
+	int nScenarios = 100;
+	double sigma = 0.1, mean = 1.0;
+	unsigned int seed = 1;
+	int nThreads = 1;
+	bool bench = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "M:K:n:G:s:J:b")) != -1) {
+		switch (opt) {
+		case 'M':
+			modelFile = optarg;
+			break;
+		case 'K':
+			correlationFile = optarg;
+			break;
+		case 'n':
+			nScenarios = atoi(optarg);
+			break;
+		case 'G':
+			sigma = atof(optarg);
+			if (strchr(optarg, ',') != NULL) mean = atof(strchr(optarg, ',') + 1);
+			break;
+		case 's':
+			seed = atoi(optarg);
+			break;
+		case 'J':
+			nThreads = atoi(optarg) > 0 ? atoi(optarg) : hardware_threads();
+			break;
+		case 'b':
+			bench = true;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-M model] [-K correlation] [-n scenarios] [-G sigma[,mean]] [-s seed] [-J threads] [-b]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	PortfolioModel model;
+	if (modelFile != NULL)
+		load_model(modelFile, model);
+	else
+		builtin_model(model);
+
+	const int nPrograms = model.nPrograms;
+	boost::numeric::ublas::matrix<double> correlation;
+	if (correlationFile != NULL) {
+		load_correlation(correlationFile, nPrograms, correlation);
+	} else {
+		correlation = boost::numeric::ublas::identity_matrix<double>(nPrograms);
+	}
+
+	CorrelatedSampler sampler;
+	ThreadPool pool(nThreads);
+	init_sampler(sampler, correlation, seed);
+
+	if (bench) {
+		benchmark(model, sampler, nScenarios, sigma, mean, &pool);
+		return EXIT_SUCCESS;
+	}
+
+	vector<double> multipliers((size_t)nPrograms * nScenarios);
+	correlated_multipliers(sampler, nScenarios, sigma, mean, &multipliers[0], &pool);
+
+	for (int s = 0; s < nScenarios; s++) {
+		for (int progIdx = 0; progIdx < nPrograms; progIdx++)
+			printf(progIdx == 0 ? "%.6f" : " %.6f", multipliers[(size_t)progIdx * nScenarios + s]);
+		printf("\n");
+	}
+
+	return EXIT_SUCCESS;
+}
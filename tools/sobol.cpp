@@ -0,0 +1,149 @@
+/* sobol.cpp
+ Sobol sensitivity of one portfolio's objectives and budget constraint to the
+ uncertainty multipliers and the four scales.  Prints one line per output and
+ input: first-order index with its bootstrap interval, then total index with
+ its interval.
+
+ Usage: sobol.exe [-M model] [-O options] [-N samples] [-R replicates] [-c level]
+                  [-u lo,hi] [-r lo,hi] [-s seed] [-J threads]
+   -M  model file (defaults to the table in modeldfn.h)
+   -O  the portfolio, one option index or a comma-separated list (default 0)
+   -N  base samples, for N*(inputs+2) evaluations (default 10000)
+   -R  bootstrap replicates (default 100)
+   -c  confidence level of the intervals (default 0.95)
+   -u  range of the uncertainty multipliers (default 0.75,1.25)
+   -r  range of the bau, ss, cost and budget scales (default 0.9,1.1)
+   -s  random seed (default 1)
+   -J  threads (default: hardware threads)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "sobol.h"
+
+using namespace std;
+
+static vector<int> parse_list(const char* arg) {
+	vector<int> values;
+	char* end;
+
+	for (long value = strtol(arg, &end, 10); end != arg; value = strtol(arg, &end, 10)) {
+		values.push_back((int)value);
+		arg = (*end == ',') ? end + 1 : end;
+	}
+
+	return values;
+}
+
+static void parse_range(const char* arg, double& lower, double& upper) {
+	lower = atof(arg);
+	upper = (strchr(arg, ',') != NULL) ? atof(strchr(arg, ',') + 1) : lower;
+
+	if (!(upper >= lower)) {
+		fprintf(stderr, "Invalid range %s\n", arg);
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const char* modelFile = NULL;
+	vector<int> opts;
+	SobolOptions options;
+	double uLower = 0.75, uUpper = 1.25, sLower = 0.9, sUpper = 1.1;
+	int nThreads = hardware_threads();
+	int opt;
+
+	options.nBase = 10000;
+	options.nBootstrap = 100;
+	options.confidence = 0.95;
+	options.seed = 1;
+
+	while ((opt = getopt(argc, argv, "M:O:N:R:c:u:r:s:J:")) != -1) {
+		switch (opt) {
+		case 'M':
+			modelFile = optarg;
+			break;
+		case 'O':
+			opts = parse_list(optarg);
+			break;
+		case 'N':
+			options.nBase = max(1, atoi(optarg));
+			break;
+		case 'R':
+			options.nBootstrap = max(0, atoi(optarg));
+			break;
+		case 'c':
+			options.confidence = atof(optarg);
+			break;
+		case 'u':
+			parse_range(optarg, uLower, uUpper);
+			break;
+		case 'r':
+			parse_range(optarg, sLower, sUpper);
+			break;
+		case 's':
+			options.seed = atoi(optarg);
+			break;
+		case 'J':
+			nThreads = atoi(optarg) > 0 ? atoi(optarg) : hardware_threads();
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-M model] [-O options] [-N samples] [-R replicates] [-c level] "
+					"[-u lo,hi] [-r lo,hi] [-s seed] [-J threads]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	PortfolioModel model;
+	if (modelFile != NULL)
+		load_model(modelFile, model);
+	else
+		builtin_model(model);
+
+	const int n = model.nPrograms;
+	if (opts.size() <= 1) opts.assign(n, opts.empty() ? 0 : opts[0]);
+	if ((int)opts.size() != n) {
+		fprintf(stderr, "Expected one option or one per program\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int progIdx = 0; progIdx < n; progIdx++)
+		opts[progIdx] = option_index(opts[progIdx], model.options(progIdx));
+
+	options.lower.assign(SCENARIO_INPUTS(n), sLower);
+	options.upper.assign(SCENARIO_INPUTS(n), sUpper);
+	fill_n(options.lower.begin(), n, uLower);
+	fill_n(options.upper.begin(), n, uUpper);
+
+	ThreadPool pool(nThreads);
+	SobolResult result;
+	sobol_analysis(model, &opts[0], options, result, &pool);
+
+	const char* outputs[ENSEMBLE_OUTPUTS] = { "bau", "ss", "cost", "budget" };
+	const char* scales[4] = { "bau_scale", "ss_scale", "cost_scale", "budget_scale" };
+	const int k = result.nInputs;
+
+	printf("%-8s %-12s %10s %10s %10s %10s %10s %10s\n", "output", "input",
+			"S1", "S1_low", "S1_high", "ST", "ST_low", "ST_high");
+
+	for (int o = 0; o < ENSEMBLE_OUTPUTS; o++) {
+		for (int i = 0; i < k; i++) {
+			char name[32];
+			if (i < n)
+				snprintf(name, sizeof(name), "u%d", i + 1);
+			else
+				snprintf(name, sizeof(name), "%s", scales[i - n]);
+
+			size_t idx = (size_t)o * k + i;
+			printf("%-8s %-12s %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f\n", outputs[o], name,
+					result.first[idx], result.firstLow[idx], result.firstHigh[idx],
+					result.total[idx], result.totalLow[idx], result.totalHigh[idx]);
+		}
+	}
+
+	fprintf(stderr, "%d evaluations\n", options.nBase * (k + 2));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+/* trace.cpp
+ Writing and reading of binary evaluation traces.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+#include "ensemble.h"
+
+using namespace std;
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t record_size(int nWords, int nConstraints) {
+	return 16 + nWords * sizeof(uint64_t) + (nColumns + nConstraints) * sizeof(double);
+}
+
+void open_trace(TraceWriter& trace, const char* filename, const PortfolioModel& model, const Scenario& base,
+		int nConstraints) {
+	const int n = model.nPrograms;
+
+	if ((trace.file = fopen(filename, "wb")) == NULL) {
+		fprintf(stderr, "Unable to open %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	build_genome_layout(model, trace.layout);
+	trace.nConstraints = nConstraints;
+	trace.opts.resize(n);
+	trace.record.assign(record_size(trace.layout.nWords, nConstraints), 0);
+
+	TraceHeader header;
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.nPrograms = n;
+	header.nWords = trace.layout.nWords;
+	header.nConstraints = nConstraints;
+
+	vector<double> inputs(base.uncertainty.begin(), base.uncertainty.end());
+	inputs.resize(SCENARIO_INPUTS(n));
+	inputs[INPUT_BAU_SCALE(n)] = base.bauScale;
+	inputs[INPUT_SS_SCALE(n)] = base.ssScale;
+	inputs[INPUT_COST_SCALE(n)] = base.costScale;
+	inputs[INPUT_BUDGET_SCALE(n)] = base.budgetScale;
+
+	if (fwrite(&header, sizeof(header), 1, trace.file) != 1 ||
+			fwrite(&trace.layout.options[0], sizeof(uint16_t), n, trace.file) != (size_t)n ||
+			fwrite(&inputs[0], sizeof(double), inputs.size(), trace.file) != inputs.size()) {
+		fprintf(stderr, "Unable to write %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	trace.start = now();
+}
+
+void trace_record(TraceWriter& trace, uint32_t scenario, const uint8_t* opts, const double* objs,
+		const double* consts) {
+	char* record = &trace.record[0];
+	const int nWords = trace.layout.nWords;
+
+	copy(opts, opts + trace.layout.nPrograms, trace.opts.begin());
+	*(uint64_t*)record = (uint64_t)((now() - trace.start) * 1e9);
+	*(uint32_t*)(record + 8) = scenario;
+	pack_genome(trace.layout, &trace.opts[0], (uint64_t*)(record + 16));
+	memcpy(record + 16 + nWords * sizeof(uint64_t), objs, nColumns * sizeof(double));
+	memcpy(record + 16 + nWords * sizeof(uint64_t) + nColumns * sizeof(double), consts,
+			trace.nConstraints * sizeof(double));
+
+	if (fwrite(record, trace.record.size(), 1, trace.file) != 1) {
+		fprintf(stderr, "Unable to write the trace\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void close_trace(TraceWriter& trace) {
+	if (fclose(trace.file) != 0) {
+		fprintf(stderr, "Unable to write the trace\n");
+		exit(EXIT_FAILURE);
+	}
+	trace.file = NULL;
+}
+
+void read_trace(const char* filename, Trace& trace) {
+	FILE* file = fopen(filename, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	TraceHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || strncmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+			header.version != TRACE_VERSION) {
+		fprintf(stderr, "%s is not a version %d trace\n", filename, TRACE_VERSION);
+		exit(EXIT_FAILURE);
+	}
+
+	const int n = header.nPrograms;
+	trace.nPrograms = n;
+	trace.nWords = header.nWords;
+	trace.nConstraints = header.nConstraints;
+	trace.options.resize(n);
+	trace.baseInputs.resize(SCENARIO_INPUTS(n));
+	trace.recordSize = record_size(trace.nWords, trace.nConstraints);
+
+	if (fread(&trace.options[0], sizeof(uint16_t), n, file) != (size_t)n ||
+			fread(&trace.baseInputs[0], sizeof(double), trace.baseInputs.size(), file) != trace.baseInputs.size()) {
+		fprintf(stderr, "%s is truncated\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	/* records run to the end of the file */
+	long start = ftell(file);
+	fseek(file, 0, SEEK_END);
+	size_t size = ftell(file) - start;
+	fseek(file, start, SEEK_SET);
+
+	if (size % trace.recordSize != 0) {
+		fprintf(stderr, "%s ends in a partial record\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	trace.nRecords = size / trace.recordSize;
+	trace.records.resize(size);
+	if (size > 0 && fread(&trace.records[0], 1, size, file) != size) {
+		fprintf(stderr, "Unable to read %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	fclose(file);
+}
@@ -0,0 +1,96 @@
+/*
+ * trace.h
+ *
+ *  Binary traces of evaluations, captured from a live run with -T and
+ *  replayed by tools/replay.exe.  A trace starts with a TraceHeader, the
+ *  option count of every program (uint16) and the SCENARIO_INPUTS of the
+ *  scenario given on the command line, then holds one fixed-size record per
+ *  evaluation:
+ *
+ *    uint64_t time        nanoseconds since the capture started
+ *    uint32_t scenario    daemon library row, or TRACE_SCENARIO_BASE
+ *    uint32_t reserved
+ *    uint64_t genome[nWords]   options packed as in genome.h
+ *    double objs[nColumns]
+ *    double consts[nConstraints]
+ *
+ *  The genome holds option indices rather than the decision variables sent
+ *  by the driver, as only the option matters to the evaluation.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "genome.h"
+
+#define TRACE_MAGIC "PFTRACE"
+#define TRACE_VERSION 1
+
+#define TRACE_SCENARIO_BASE 0xffffffffu   // the scenario given on the command line
+#define TRACE_SCENARIO_INLINE 0xfffffffeu // a daemon 'multipliers' request, not replayable
+
+struct TraceHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t nPrograms;
+	uint32_t nWords;
+	uint32_t nConstraints;
+};
+
+struct TraceWriter {
+	FILE* file;
+	GenomeLayout layout;
+	int nConstraints;
+	double start;
+	std::vector<int> opts;          // scratch for packing
+	std::vector<char> record;
+};
+
+struct Trace {
+	int nPrograms;
+	int nWords;
+	int nConstraints;
+	std::vector<uint16_t> options;
+	std::vector<double> baseInputs; // SCENARIO_INPUTS of the base scenario
+	size_t recordSize;
+	size_t nRecords;
+	std::vector<char> records;
+
+	const char* record(size_t r) const {
+		return &records[r * recordSize];
+	}
+	uint64_t time(size_t r) const {
+		return *(const uint64_t*)record(r);
+	}
+	uint32_t scenario(size_t r) const {
+		return *(const uint32_t*)(record(r) + 8);
+	}
+	const uint64_t* genome(size_t r) const {
+		return (const uint64_t*)(record(r) + 16);
+	}
+	const double* objs(size_t r) const {
+		return (const double*)(record(r) + 16 + nWords * sizeof(uint64_t));
+	}
+	const double* consts(size_t r) const {
+		return objs(r) + nColumns;
+	}
+};
+
+// Starts a trace of evaluations of model, whose results have nConstraints
+// constraints, under the base scenario.  Exits if the file cannot be written.
+void open_trace(TraceWriter& trace, const char* filename, const PortfolioModel& model, const Scenario& base,
+		int nConstraints);
+
+// Appends one evaluation, given by one option index per program.
+void trace_record(TraceWriter& trace, uint32_t scenario, const uint8_t* opts, const double* objs,
+		const double* consts);
+
+void close_trace(TraceWriter& trace);
+
+// Reads a whole trace into memory.  Exits on a malformed or truncated trace.
+void read_trace(const char* filename, Trace& trace);
+
+#endif /* TRACE_H_ */